@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Arduino.h>
+
+// On-device micro and macro benchmarks of the emulator core, only compiled
+// with the build flag -DBENCHMARK (see env:esp32dev-benchmark in platformio.ini).
+// Results are measured in CPU cycles and reported as one JSON line over the
+// USB serial, prefixed with "BENCH_JSON ", to allow comparison across commits.
+
+#ifdef BENCHMARK
+
+class Benchmark {
+public:
+    static void run();
+    // event storm load test, requires a connected MQTT broker
+    static void runEventStorm();
+    // soak test, a scripted panel session of several simulated days compared to the
+    // thresholds in include/BenchmarkBaseline.h, returns false on regression
+    static bool runSoak();
+
+private:
+    struct Result {
+        const char* name;
+        uint32_t iterations;
+        uint64_t cycles;
+        uint32_t minCycles;
+        uint32_t maxCycles;
+    };
+
+    static constexpr size_t MAX_RESULTS = 24;
+    static Result results[MAX_RESULTS];
+    static size_t resultCount;
+
+    // measure body() for the given number of iterations,
+    // prepare() is called before each iteration and is not measured
+    template <typename Prepare, typename Body>
+    static void measure(const char* name, uint32_t iterations, Prepare prepare, Body body);
+
+    static void benchFixedString();
+    static void benchCharset();
+    static void benchSplitCommands();
+    static void benchDispatch();
+    static void benchMessageParser();
+    static void benchPanelSession();
+    static void benchLed();
+
+    // panel session helpers
+    static void feed(const char* line, bool textEnd = false);
+    static uint32_t runUntilIdle(Result &r);
+
+    static void report();
+
+    // event storm stages, the event rate ramps up from stage to stage
+    struct StormResult {
+        uint16_t rate;          // scheduled events per second
+        uint32_t injected;      // alarm SMS received from the simulated panel
+        uint32_t published;     // status publishes
+        uint32_t delivered;     // status publishes received by the broker stand-in (env:native)
+        uint32_t merged;        // events merged by the aggregation window
+        uint32_t dropped;       // SMS dropped, message buffer full
+        uint32_t latency[4];    // event to publish latency in ms: p50, p90, p99, max
+    };
+    static constexpr uint16_t STORM_RATES[] = {1, 2, 5, 10, 20, 50, 100};
+    static constexpr uint32_t STORM_STAGE_DURATION = 5000;  // milliseconds
+    static constexpr size_t STORM_MAX_SAMPLES = 512;        // events of the fastest stage
+    static StormResult stormResults[sizeof(STORM_RATES) / sizeof(STORM_RATES[0])];
+
+    static void runStormStage(StormResult &r);
+
+    // soak test: the panel polls +CSQ and +CREG? every SOAK_TICK simulated minutes, sends an
+    // alarm SMS every SOAK_ALARM_TICKS and HA sends an arm/disarm command every SOAK_COMMAND_TICKS.
+    // On the host a virtual clock advances 1 ms per loop and runs the time between the ticks
+    // in SOAK_IDLE_STEP steps (background status polls, TTL), on the device the exchanges run
+    // back-to-back in real time, without the time between the ticks
+#ifdef NATIVE
+    static constexpr uint32_t SOAK_DAYS = 7;
+#else
+    static constexpr uint32_t SOAK_DAYS = 1;
+#endif
+    static constexpr uint32_t SOAK_TICK = 10;           // simulated minutes
+    static constexpr uint32_t SOAK_IDLE_STEP = 1000;    // milliseconds per loop between the ticks
+    static constexpr uint32_t SOAK_ALARM_TICKS = 12;
+    static constexpr uint32_t SOAK_COMMAND_TICKS = 36;
+    static constexpr uint32_t SOAK_TIMEOUT = 10000;     // milliseconds per exchange
+    static constexpr uint32_t SOAK_BUCKET = 10;         // milliseconds per latency histogram bucket
+    static constexpr size_t SOAK_BUCKETS = 256;
+    struct SoakResult {
+        uint32_t exchanges;
+        uint32_t timeouts;
+        uint32_t latency[3];    // milliseconds: p50, p99, max
+        size_t commandDepth;
+        size_t responseDepth;
+        size_t messageDepth;
+        size_t arenaBlocks;
+        uint32_t minFreeHeap;
+        uint32_t minFreeStack;
+    };
+    static SoakResult soak;
+    static uint16_t soakHistogram[SOAK_BUCKETS];
+
+    static bool isIdle();
+    static void soakExchange(const char* line, bool textEnd = false);
+    static void soakLoop(uint32_t ms);
+    static void soakIdle(uint32_t until, bool &armed);
+    static void soakSample();
+    static void soakServeCommand(bool &armed);
+    static uint32_t soakPercentile(uint32_t percent);
+    static bool soakCheck(const char* name, uint32_t value, uint32_t limit, bool lowerLimit = false);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ModemScripts.h"
+
+// Golden thresholds of the soak test (Benchmark::runSoak), a result beyond a threshold
+// is reported as regression. Update the thresholds with the change that intentionally
+// alters the timing or memory use and note the reason in the commit.
+// The latency thresholds are derived, not recorded on the device: a response of n lines
+// takes n * Scripts::responseDelay plus the emulator's loop time (LOOP_ALLOWANCE), which is
+// only checked on the host so far. The device reports its latencies without checking
+// them until LOOP_ALLOWANCE is recorded there, as the host skips heap and stack. Most
+// exchanges have 2 lines (+CSQ, +CREG?, +CMGS), reading an SMS 3 (+CMGR, body, OK), the
+// longest is ATZ with OK and the 5 startup lines. With the virtual clock of env:native
+// (7 simulated days, 1 ms per loop) the soak test gives p50 210 ms, p99 320 ms, max 614 ms,
+// depths 3 / 5 / 0 and 1 arena block.
+namespace Baseline {
+
+constexpr uint32_t LOOP_ALLOWANCE = 50;     // milliseconds per exchange
+
+// panel command to completed response, milliseconds
+constexpr uint32_t latencyP50 = 2 * Scripts::responseDelay + LOOP_ALLOWANCE;
+constexpr uint32_t latencyP99 = 3 * Scripts::responseDelay + LOOP_ALLOWANCE;
+constexpr uint32_t latencyMax = 6 * Scripts::responseDelay + LOOP_ALLOWANCE;
+constexpr uint32_t timeouts = 0;            // exchanges without response
+
+// peak queue depths, the panel sends one line at a time
+constexpr size_t commandDepth = 4;          // Sim900::commands
+constexpr size_t responseDepth = 6;         // Sim900::response, ATZ response
+constexpr size_t messageDepth = 2;          // Sim900::msgRxBuffer and msgTxBuffer
+constexpr size_t arenaBlocks = 4;           // SmsArena blocks in use
+
+// memory, lowest values during the soak test, conservative limits until recorded on the device
+constexpr uint32_t minFreeHeap = 100000;    // bytes
+constexpr uint32_t minFreeStack = 1024;     // bytes, loop task
+
+} // namespace Baseline
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FixedString.h"
+
+// Transcoding of SMS text between the character set selected by the host (+CSCS)
+// and UTF-8, used for MQTT. All lookup tables are constexpr, the functions append
+// to a preallocated buffer and truncate if it is full (no heap use).
+//
+// Supported character sets:
+// - GSM:  GSM 03.38 7-bit default alphabet incl. extension table, one septet per byte
+// - IRA:  7-bit ASCII (SIM900 default)
+// - UCS2: 16-bit code units as 4 hex digits each, characters beyond the BMP as
+//         UTF-16 surrogate pair
+namespace Charset {
+
+enum class Type : uint8_t {
+    IRA,
+    GSM,
+    UCS2
+};
+
+// byte stored instead of GSM '@' (0x00), which can't be kept in a C string
+static constexpr char GSM_AT_PLACEHOLDER = (char)0x80;
+
+// parse the argument of +CSCS=, e.g. "GSM" (with quotes), returns false if not supported
+bool parse(const char* name, Type &out);
+const char* name(Type type);
+
+// output is truncated at the first character which doesn't fit completely
+
+// host character set to UTF-8, line breaks are replaced by '|'
+void decode(Type type, const char* in, char* out, size_t &len, size_t size);
+// UTF-8 to host character set, characters which can't be represented are replaced by '?'
+void encode(Type type, const char* in, char* out, size_t &len, size_t size);
+
+template <size_t N>
+inline void decode(Type type, const char* in, FixedString<N> &out) {
+    decode(type, in, out.buf, out.len, N);
+}
+
+template <size_t N>
+inline void encode(Type type, const char* in, FixedString<N> &out) {
+    encode(type, in, out.buf, out.len, N);
+}
+
+} // namespace Charset
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ArduinoHA.h>
+
+// MQTT broker port
+constexpr uint16_t BROKER_PORT = 1883;
+
+/**
+ * @class ManagedClient
+ * @brief Client of the MQTT library on a non-blocking socket opened by the ConnectionManager.
+ *
+ * connect() never opens a connection, a reconnect attempt of the MQTT library on its own
+ * (e.g. after a keep-alive timeout) fails at once instead of blocking on the socket connect
+ * and the CONNACK. Writes never block, a packet which doesn't fit into the send buffer
+ * closes the connection, a partial packet would corrupt the stream. The MQTT library waits
+ * for CONNACK and the rest of a packet in a busy loop, a wait beyond the deadline closes
+ * the connection and reads fail, so the wait ends. The reason of a close is kept for the log.
+ */
+class ManagedClient : public Client {
+public:
+    // take over a connected non-blocking socket
+    void attach(int fd);
+    // calls waiting for data beyond timeout microseconds fail
+    void startDeadline(uint32_t timeout) {
+        deadline = micros() + timeout;
+        armed = true;
+        polling = false;
+        expired = false;
+    }
+    void stopDeadline() { armed = false; }
+    bool deadlineExpired() const { return expired; }
+    // why the connection was closed, nullptr: open or stopped
+    const char* getError() const { return error; }
+
+    int connect(IPAddress ip, uint16_t port) override { return connected(); }
+    int connect(const char* host, uint16_t port) override { return connected(); }
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) { return connected(); }
+    int connect(const char* host, uint16_t port, int32_t timeout) { return connected(); }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override { drop(nullptr); }
+    uint8_t connected() override { return fd >= 0; }
+    operator bool() override { return connected(); }
+
+private:
+    static constexpr size_t RX_SIZE = 128;
+
+    int fd = -1;
+    uint8_t rx[RX_SIZE];            // received data not yet read by the MQTT library
+    size_t rxStart = 0;
+    size_t rxEnd = 0;
+    uint32_t deadline = 0;          // micros()
+    bool armed = false;
+    bool polling = false;           // no data after the deadline, the next empty check expires
+    bool expired = false;
+    const char* error = nullptr;
+
+    size_t receive();
+    void drop(const char* reason);
+};
+
+/**
+ * @class ConnectionManager
+ * @brief Non-blocking WiFi and MQTT connection handling, reconnects never stall the modem.
+ *
+ * The TCP connection to the broker is opened on a non-blocking socket which is polled
+ * from loop(), the MQTT session is only started on an established connection, so a
+ * broker which is down or slow to accept doesn't block the main loop for the socket
+ * connect timeout. Failed attempts are retried with exponential backoff and jitter.
+ *
+ * The MQTT library can't reconnect on its own (see ManagedClient), its state is reset
+ * on each failure, so a new socket always starts with CONNECT. Each call of loop() runs
+ * at most one step of the state machine. The socket stays non-blocking, in a session the
+ * reads of the MQTT library wait at most until NETWORK_BUDGET is spent, a packet not
+ * complete by then ends the session. The one exception is the session setup, the MQTT
+ * library sends CONNECT and waits for CONNACK in one call, bounded by CONNACK_TIMEOUT.
+ * A step exceeding NETWORK_BUDGET defers the next one by the overrun, so the modem gets
+ * at least the same time.
+ */
+class ConnectionManager {
+public:
+    enum class State : uint8_t {
+        WifiConnecting,     // waiting for WiFi
+        Backoff,            // waiting for the next connection attempt
+        TcpConnecting,      // broker TCP connect in progress
+        MqttConnecting,     // MQTT session setup
+        Connected
+    };
+
+    struct Stats {
+        uint32_t attempts = 0;      // broker connection attempts
+        uint32_t failures = 0;      // failed attempts and lost connections
+        uint32_t overruns = 0;      // steps exceeding NETWORK_BUDGET
+        uint32_t maxStep = 0;       // microseconds, longest step
+    };
+
+    ConnectionManager(HAMqtt &mqtt, ManagedClient &client, IPAddress broker, uint16_t port = BROKER_PORT)
+        : mqtt(mqtt), client(client), broker(broker), port(port) {};
+    bool begin(const char* username, const char* password);
+    void loop();
+
+    State getState() const { return state; }
+    bool isConnected() const { return state == State::Connected; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    static constexpr uint32_t RECONNECT_MIN = 10000;        // milliseconds
+    static constexpr uint32_t RECONNECT_MAX = 160000;       // milliseconds
+    static constexpr uint32_t TCP_CONNECT_TIMEOUT = 5000;   // milliseconds
+    static constexpr uint32_t NETWORK_BUDGET = 5000;        // microseconds per step
+    static constexpr uint32_t CONNACK_TIMEOUT = 100000;     // microseconds, about one modem response delay
+
+    HAMqtt &mqtt;
+    ManagedClient &client;
+    const char* username = nullptr;
+    const char* password = nullptr;
+    IPAddress broker;
+    uint16_t port;
+
+    State state = State::WifiConnecting;
+    Stats stats;
+    int fd = -1;                    // socket while the TCP connect is in progress
+    uint32_t stateTime = 0;         // time the current state was entered
+    uint32_t backoff = RECONNECT_MIN;
+    uint32_t retryDelay = RECONNECT_MIN;    // backoff with jitter
+    uint32_t deferStart = 0;        // next step deferred after an overrun
+    uint32_t deferTime = 0;
+
+    void step(uint32_t now);
+    void setState(State newState);
+    void startConnect();
+    void pollConnect(uint32_t now);
+    void closeSocket();
+    void dropSession();
+    void mqttLoop(uint32_t timeout);
+    void fail(const char* reason);
+};
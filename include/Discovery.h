@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoHA.h>
+
+// Fast reconnect: discovery configs are published retained, so the broker keeps them while
+// the emulator reconnects. They are serialized and published on the first connection and
+// again after Home Assistant restarted (birth message "online" on <prefix>/status), other
+// reconnects only send availability and subscriptions before the status flows.
+namespace Discovery {
+
+// subscribe to the Home Assistant birth message
+void begin(HAMqtt &mqtt);
+// to be called after each (re)connect, marks the configs as published
+void connected(HAMqtt &mqtt);
+
+bool isPublished();
+void setPublished(bool published);
+// true if Home Assistant restarted and expects the configs again, clears the request
+bool takeRequest();
+
+// entity which skips building its discovery config once it was published
+template <class T>
+class Cached : public T {
+public:
+    using T::T;
+    // publish the config again, e.g. after Home Assistant restarted
+    void republish() { this->publishConfig(); }
+
+protected:
+    // without serializer, publishConfig() returns early
+    void buildSerializer() override {
+        if (!isPublished())
+            T::buildSerializer();
+    }
+};
+
+} // namespace Discovery
@@ -1,5 +1,6 @@
 #pragma once
 #include <Arduino.h>
+#include <esp_timer.h>
 
 /**
  * @class LEDControl
@@ -7,16 +8,19 @@
  *
  * This class provides an interface to manage an LED connected to a specified pin.
  * It supports regular LED states (on, off, slow blink, fast blink) and allows for
- * one-shot flash patterns for indication purposes. Timing for blinking and flashing
- * is handled internally.
+ * one-shot flash patterns for indication purposes. Patterns are compile-time tables
+ * of on/off steps, played by a periodic ESP timer, independent of the main loop.
  *
  * Usage:
  * - Instantiate with the desired pin number. Inverted logic can be set if the LED is active LOW.
+ * - Call begin() once to start the timer.
  * - Use setState() to set the regular LED state.
- * - Call indicate() to trigger a one-shot flash pattern.
- * - Call loop() periodically (e.g. in the main loop) to handle timing and state changes.
+ * - Call indicate() to trigger a one-shot flash pattern, overlaid on the regular state.
  */
 class LEDControl {
+#ifdef BENCHMARK
+    friend class Benchmark;
+#endif
 public:
     enum LedState : uint8_t {
         LED_OFF,
@@ -27,7 +31,7 @@ public:
 
     LEDControl(uint8_t pin, bool inverted = false);
 
-    void loop();
+    void begin();
 
     void setState(LedState newState);  // regular led state
     void indicate(uint8_t flashNum);   // one-shot flash pattern
@@ -37,28 +41,56 @@ private:
     bool inverted;  // if true, LED is active LOW (on when pin is LOW)
     bool ledState = false;
 
-    LedState currentState = LED_OFF;
-    LedState savedState = LED_OFF;
-
-    // regular blink timing
-    uint32_t lastToggle = 0;
+    // pattern timing, all durations are multiples of the timer tick
+    static constexpr uint32_t TICK = 50;    // milliseconds
     static constexpr uint16_t BLINK_SLOW = 500;
     static constexpr uint16_t BLINK_FAST = 250;
-
-    // one-shot flash control
-    bool flashActive = false;
-    uint8_t flashCount = 0;
-    uint8_t flashesDone = 0;
-    uint32_t flashTimer = 0;
     static constexpr uint16_t FLASH_INTERVAL = 100;
 
+    struct Step {
+        bool on;
+        uint8_t ticks;  // 0: hold
+    };
+    struct Pattern {
+        const Step* steps;
+        uint8_t count;
+    };
+    static_assert(BLINK_SLOW % TICK == 0 && BLINK_FAST % TICK == 0 && FLASH_INTERVAL % TICK == 0,
+                  "durations must be multiples of the tick");
+
+    static constexpr Step offSteps[] = {{false, 0}};
+    static constexpr Step onSteps[] = {{true, 0}};
+    static constexpr Step slowSteps[] = {{true, BLINK_SLOW / TICK}, {false, BLINK_SLOW / TICK}};
+    static constexpr Step fastSteps[] = {{true, BLINK_FAST / TICK}, {false, BLINK_FAST / TICK}};
+    static constexpr Step flashSteps[] = {{false, FLASH_INTERVAL / TICK}, {true, FLASH_INTERVAL / TICK}};
+    // regular patterns, indexed by LedState
+    static constexpr Pattern patterns[] = {
+        {offSteps, 1}, {onSteps, 1}, {slowSteps, 2}, {fastSteps, 2}
+    };
+    static constexpr Pattern flashPattern = {flashSteps, 2};
+
+    // pattern being played, the overlay (one-shot flashes) replaces the regular state while active
+    struct Layer {
+        const Pattern* pattern = &patterns[LED_OFF];
+        uint8_t step = 0;
+        uint8_t ticksLeft = 0;
+        uint16_t stepsLeft = 0; // remaining steps incl. the current one, 0: forever
+    };
+    Layer base;
+    Layer overlay;
+    bool overlayActive = false;
+
+    // sequencer state and pin are shared with the timer task, the pin is written under the mux,
+    // so a write can't be overtaken by an older one from the other core
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    esp_timer_handle_t timer = nullptr;
+
+    static void onTick(void* arg);
+    void tick();
+    static bool start(Layer &layer, const Pattern &pattern, uint16_t steps);
+
     void set(bool state) {
         ledState = state;
         digitalWrite(pin, (state ^ inverted));
     }
-
-    void toggle() {
-        ledState = !ledState;
-        set(ledState);
-    }
 };
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstring>
+
+// Command-to-response scripts of the emulated SIM900 modem.
+// All tables are constexpr and end up in flash (.rodata), the response queue
+// only holds pointers to the lines. Lines with text == nullptr are dynamic,
+// their content is taken from a separate buffer (e.g. +CMGR header, SMS body).
+//
+// The panel profile is selected at compile time:
+// - default: Blaupunkt SA2700
+// - build flag -DPANEL_SA2500: Blaupunkt SA2500
+
+// a single response line, sent to the host after the given delay
+struct ScriptLine {
+    const char* text;   // nullptr: dynamic line
+    uint16_t delay;     // delay in milliseconds before sending this line
+};
+
+// sequence of response lines, optionally chained to a follow-up script
+struct Script {
+    const ScriptLine* lines;
+    uint8_t count;
+    const Script* next = nullptr;
+};
+
+// AT command mapped to its response script
+struct CommandScript {
+    const char* command;
+    bool prefix;            // true: match command prefix, false: exact match
+    const Script* script;
+
+    bool matches(const char* cmd) const {
+        if (prefix)
+            return strncmp(cmd, command, strlen(command)) == 0;
+        return strcmp(cmd, command) == 0;
+    }
+};
+
+template <size_t N>
+constexpr Script makeScript(const ScriptLine (&lines)[N], const Script* next = nullptr) {
+    return Script{lines, static_cast<uint8_t>(N), next};
+}
+
+template <size_t N>
+constexpr size_t tableSize(const CommandScript (&)[N]) { return N; }
+
+namespace Scripts {
+
+static constexpr uint16_t responseDelay = 100;  // default delay before each response line
+
+// placeholder for a line materialized at runtime
+inline constexpr ScriptLine dynamicLine{nullptr, responseDelay};
+// placeholder for the SMS body read by the host (+CMGR)
+inline constexpr ScriptLine smsBodyLine{nullptr, responseDelay};
+
+inline constexpr ScriptLine okLines[]     = {{"OK", responseDelay}};
+inline constexpr ScriptLine errorLines[]  = {{"ERROR", responseDelay}};
+inline constexpr ScriptLine promptLines[] = {{">", responseDelay}};
+inline constexpr ScriptLine smsSentLines[] = {
+    {"+CMGS: 123", responseDelay},  // simulate SMS sent response
+    {"OK", responseDelay}
+};
+inline constexpr ScriptLine readyLines[] = {
+    {"RDY", responseDelay},
+    {"+CSMINS: 1,1", responseDelay},
+    {"+CFUN: 1", responseDelay},
+    {"+CPIN: READY", responseDelay},
+    {"Call Ready", responseDelay}
+};
+// the emulator keeps a single SMS, it is indicated and read at index smsId
+inline constexpr char smsId[] = "1";
+inline constexpr ScriptLine cmtiLines[] = {{"+CMTI: \"SM\",1", responseDelay}};
+inline constexpr ScriptLine powerDownLines[] = {{"NORMAL POWER DOWN", responseDelay}};
+inline constexpr ScriptLine cpinLines[] = {{"+CPIN: READY", responseDelay}, {"OK", responseDelay}};
+inline constexpr ScriptLine cclkLines[] = {{"+CCLK: \"25/01/01,12:00:00+08\"", responseDelay}, {"OK", responseDelay}};
+inline constexpr ScriptLine csqLines[]  = {{"+CSQ: 23,0", responseDelay}, {"OK", responseDelay}};
+inline constexpr ScriptLine cregLines[] = {{"+CREG: 0,1", responseDelay}, {"OK", responseDelay}};
+
+inline constexpr Script ok      = makeScript(okLines);
+inline constexpr Script error   = makeScript(errorLines);
+inline constexpr Script prompt  = makeScript(promptLines);
+inline constexpr Script smsSent = makeScript(smsSentLines);
+inline constexpr Script ready   = makeScript(readyLines);
+inline constexpr Script startup = makeScript(okLines, &ready);          // ATZ: OK, then startup messages
+inline constexpr Script powerDown = makeScript(powerDownLines, &startup); // +CPOWD=1: power down, then restart
+inline constexpr Script cmti    = makeScript(cmtiLines);        // unsolicited SMS indication
+inline constexpr Script cpin    = makeScript(cpinLines);
+inline constexpr Script cclk    = makeScript(cclkLines);
+inline constexpr Script csq     = makeScript(csqLines);
+inline constexpr Script creg    = makeScript(cregLines);
+
+} // namespace Scripts
+
+namespace SA2700 {
+
+inline constexpr char name[] = "SA2700";
+
+inline constexpr CommandScript commands[] = {
+    {"AT",               false, &Scripts::ok},       // basic attention command
+    {"ATH",              false, &Scripts::ok},       // hang up
+    {"+CMGF=1",          false, &Scripts::ok},       // set SMS text mode
+    {"+CNMI=3,1",        false, &Scripts::ok},       // new SMS message indications
+    {"+CMGDA=\"DEL ALL\"", false, &Scripts::ok},     // delete all SMS messages
+    {"+IPR=",            true,  &Scripts::ok},       // set fixed baud rate
+    {"+CMGD=",           true,  &Scripts::ok},       // delete SMS message by index
+    {"+CLTS=",           true,  &Scripts::ok},       // set local time stamp
+    {"+CSCLK=",          true,  &Scripts::ok},       // set slow clock mode
+    {"+CMEE=",           true,  &Scripts::ok},       // set extended error reporting
+    {"+CSDT=",           true,  &Scripts::ok},       // set data type
+    {"+MORING=",         true,  &Scripts::ok},       // set MO ring
+    {"+CSMINS=",         true,  &Scripts::ok},       // SIM card status
+    {"+CSMP=",           true,  &Scripts::ok},       // set SMS parameters
+    {"ATZ",              false, &Scripts::startup},  // reset the modem
+    {"+CPOWD=1",         false, &Scripts::powerDown},// power down the modem
+    {"+CPIN?",           true,  &Scripts::cpin},     // simulate SIM card ready status
+    {"+CCLK?",           false, &Scripts::cclk},     // current clock request
+    {"+CSQ",             false, &Scripts::csq},      // signal quality request
+    {"+CREG?",           false, &Scripts::creg},     // network registration status request
+};
+
+} // namespace SA2700
+
+namespace SA2500 {
+
+inline constexpr char name[] = "SA2500";
+
+// no deviations from the SA2700 command set are known so far, the table is shared,
+// replace the alias with an own table once a panel specific response is needed
+inline constexpr const auto &commands = SA2700::commands;
+
+} // namespace SA2500
+
+#ifdef PANEL_SA2500
+namespace Panel = SA2500;
+#else
+namespace Panel = SA2700;
+#endif
@@ -5,30 +5,73 @@
 #include <PrintStream.h>
 #include <FIFObuf.h>
 #include "FixedString.h"
+#include "ModemScripts.h"
+#include "Trace.h"
+#include "Charset.h"
+#include "SmsArena.h"
+
+// SMS body stored in the SmsArena, with the id of the request trace it belongs to (0: none)
+struct SmsMessage {
+    SmsHandle body;
+    uint16_t traceId = 0;
+};
 
 class Sim900 {
+#ifdef BENCHMARK
+    friend class Benchmark;
+#endif
 public:
     Sim900(){};
     void init();
     void loop();
     void splitCommands();
-    void sendToHost(const FixedString128 &msg);
+    void sendToHost(const char* msg);
 
     inline bool messageAvailable() {
         return msgRxBuffer.size() > 0;
     }
     
-    inline bool getMessage(FixedString128 &out) {
+    inline bool getMessage(SmsText &out, uint16_t &traceId) {
         if (messageAvailable()) {
-            out = msgRxBuffer.pop();
+            SmsMessage msg = msgRxBuffer.pop();
+            arena.copy(msg.body, out);
+            traceId = msg.traceId;
+            arena.release(msg.body);
             return true;
         }
         out.clear();
+        traceId = 0;
         return false;
     }
 
-    inline bool sendMessage(const FixedString128 &msg) {
-        return msgTxBuffer.push(msg);
+    // number of received SMS dropped because the message buffer was full
+    inline uint32_t getDroppedMessages() const {
+        return droppedMessages;
+    }
+
+    // number of SMS bodies truncated because they exceeded SMS_MAX_LENGTH or the arena was full
+    inline uint32_t getSmsOverflows() const {
+        return arena.getOverflows();
+    }
+
+    // longest time between two loop() calls in microseconds, since the last reset
+    inline uint32_t getMaxLoopGap() const {
+        return maxLoopGap;
+    }
+    inline void resetMaxLoopGap() {
+        maxLoopGap = 0;
+    }
+
+    // ready for the next SMS to the host: the previous one was read and the panel's reply
+    // received, an SMS not read or answered within REPLY_TIMEOUT is given up
+    inline bool readyToSend() {
+        if (msgTxBuffer.size() > 0 || receiveSMS)
+            return false;
+        return !(smsTx.valid() || replyPending) || millis() - smsTxTime >= REPLY_TIMEOUT;
+    }
+
+    inline bool sendMessage(const char* msg, uint16_t traceId = 0) {
+        return pushMessage(msgTxBuffer, msg, traceId);
     }
 
 private:
@@ -37,25 +80,56 @@ private:
     static constexpr int MODEM_RX = 17;
     static constexpr unsigned long MODEM_BAUD = 9600;
 
-    static constexpr int responseDelay = 100; // delay in milliseconds before sending a response
     HardwareSerial ModemSerial{1};
 
-    static constexpr char smsId[] = "1";
     static constexpr char phoneNumber[] = "+4915773807779";
 
-    FixedString128 rxBuffer; 
+    static constexpr size_t MAX_LINE = 384;  // e.g. SMS body line of 70 UCS2 characters
+    FixedString<MAX_LINE> rxBuffer;             // longer SMS body lines are decoded in parts
+    bool smsLineOpen = false;   // part of the current SMS body line already decoded
     FIFObuf<FixedString128> commands = FIFObuf<FixedString128>(16); // buffer for commands received from the host
-    FIFObuf<FixedString128> response = FIFObuf<FixedString128>(16); // buffer for responses to be sent to the host
+    // responses to be sent to the host, static lines reference the script tables in flash,
+    // dynamic lines (e.g. +CMGR header) are materialized in responseText,
+    // the SMS body line is sent directly from the arena
+    static constexpr size_t RESPONSE_LINES = 16;
+    static constexpr size_t RESPONSE_TEXTS = 4;
+    static constexpr size_t READ_LINES = 2 + Scripts::ok.count;    // +CMGR header, body, OK
+    FIFObuf<const ScriptLine*> response = FIFObuf<const ScriptLine*>(RESPONSE_LINES);
+    FIFObuf<FixedString128> responseText = FIFObuf<FixedString128>(RESPONSE_TEXTS);
+    const ScriptLine* nextResponse = nullptr; // response line waiting for its delay to expire
     // sms processing buffers
-    FixedString128 smsNumber; 
-    FixedString128 smsRxBuffer; // SMS host to modem
-    FixedString128 smsTxBuffer; // SMS modem to host
-    FIFObuf<FixedString128> msgRxBuffer = FIFObuf<FixedString128>(16);  // buffer for received SMS messages
-    FIFObuf<FixedString128> msgTxBuffer = FIFObuf<FixedString128>(16);  // buffer for transmitted SMS messages
+    SmsArena arena;             // storage of all SMS bodies
+    FixedString128 smsNumber;
+    SmsHandle smsRx;            // SMS host to modem
+    SmsHandle smsTx;            // SMS modem to host, indicated by +CMTI
+    SmsHandle smsTxSending;     // SMS modem to host, read by the host and being sent
+    SmsText smsText;            // scratch buffer to transcode a complete SMS body
+    uint16_t smsTxTrace = 0;    // trace id of the SMS in smsTx
+    uint16_t replyTrace = 0;    // trace id assigned to the next SMS received from the host
+    bool replyPending = false;  // SMS read by the host, its reply not yet received
+    unsigned long smsTxTime = 0;    // time smsTx was indicated or read
+    static constexpr unsigned long REPLY_TIMEOUT = 30000;   // milliseconds
+    uint32_t droppedMessages = 0;
+    FIFObuf<SmsMessage> msgRxBuffer = FIFObuf<SmsMessage>(16);  // buffer for received SMS messages
+    FIFObuf<SmsMessage> msgTxBuffer = FIFObuf<SmsMessage>(16);  // buffer for transmitted SMS messages
+
+    void queueScript(const Script &script);
+    void queueLine(const FixedString128 &line);
+    const Script* findScript(const char* cmd) const;
+    void startResponse();
+    void receiveSmsChar(char c);
+    void receiveSmsLine(bool end);
+    void decodeSmsLine(bool complete);
+    void sendSmsBody();
+    bool pushMessage(FIFObuf<SmsMessage> &buf, const char* text, uint16_t traceId);
+    void clearMessages(FIFObuf<SmsMessage> &buf);
+
+    Charset::Type charset = Charset::Type::IRA; // character set selected by the host (+CSCS)
 
     bool receiveSMS = false; // true if the modem is waiting for an SMS body
-    bool textEnd = false;    // true if the last character was a text end (Ctrl+Z)
     unsigned long delayCount = 0;
+    uint32_t lastLoop = 0;      // micros() of the last loop() call
+    uint32_t maxLoopGap = 0;
     enum class ModemState {
         Idle,
         ReceiveCommand,
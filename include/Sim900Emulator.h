@@ -16,8 +16,27 @@ constexpr unsigned long MONITOR_BAUD = 115200;
 // min. update interval for MQTT status sensor
 constexpr unsigned long MQTT_KEEP_ALIVE = 60000;  // milliseconds
 
+// cached panel status, considered stale if not refreshed within this time
+constexpr unsigned long STATUS_TTL = 15 * 60000UL;  // milliseconds
+
+// adaptive background status polling: the interval doubles while the status
+// is stable and is reset to the minimum after events, changes or failed polls
+constexpr unsigned long POLL_INTERVAL_MIN = 60000UL;      // milliseconds
+constexpr unsigned long POLL_INTERVAL_MAX = 8 * 60000UL;  // milliseconds, below STATUS_TTL
+
+// panel events arriving within this time after a published event are merged into one
+// publish at the end of the window (union of sources, latest status, occurrence count),
+// changes to or from armed/disarmed and command replies are published immediately, 0: off
+constexpr unsigned long AGGREGATION_WINDOW = 2000UL;  // milliseconds
+
+// a command sent to the panel blocks further commands until the panel confirmed it
+constexpr unsigned long COMMAND_TIMEOUT = 30000UL;  // milliseconds
+
 constexpr uint8_t LED_PIN = 2; // built-in LED pin
 
+// status snapshot rendered as JSON, attributes of the status sensor plus metrics
+using SnapshotText = FixedString<3 * SMS_MAX_LENGTH + 512>;
+
 // status LED behavior:
 // - off: initializing / no WiFi
 // - slow flash: WiFi connecting
@@ -26,6 +45,9 @@ constexpr uint8_t LED_PIN = 2; // built-in LED pin
 // - three quick flashes: status update sent (keep-alive or on change)
 
 class Emulator {
+#ifdef BENCHMARK
+    friend class Benchmark;
+#endif
 public:
     Emulator(){};
     void init();
@@ -44,8 +66,41 @@ public:
         Disarmed
     };
 
+    // outbound command scheduler statistics
+    struct QueueStats {
+        uint32_t sent = 0;          // commands handed over to the modem
+        uint32_t coalesced = 0;     // requests merged into an already pending one
+        uint32_t superseded = 0;    // pending status requests dropped by arm/disarm
+        unsigned long totalWait = 0; // milliseconds, sum over all sent commands
+        unsigned long maxWait = 0;   // milliseconds
+    };
+
+    // received panel messages and resulting status publishes
+    struct EventStats {
+        uint32_t messages = 0;      // messages taken from the modem (raw events)
+        uint32_t merged = 0;        // events merged by the aggregation window
+        uint32_t aggregated = 0;    // publishes of merged events
+        uint32_t published = 0;     // status publishes
+    };
+
     bool sendCommand(const Command cmd);
     CommandState parseCommandResponse(const FixedString128 &msg);
+    void publishStatus(bool force = false);
+    // status, last message and internal metrics as JSON object, e.g. for the HTTP status endpoint
+    void renderSnapshot(SnapshotText &out) const;
+    // WiFi got an IP, the time until the first valid status is published is logged
+    void markNetworkUp() { networkUpAt = millis() | 1; }
+    const QueueStats& getQueueStats() const { return queueStats; }
+    const EventStats& getEventStats() const { return eventStats; }
+
+    // cached panel status, read without a panel round trip
+    const FixedString128& getStatus() const { return currentStatus; }
+    unsigned long getStatusAge() const { return millis() - statusUpdatedAt; }
+    bool isStatusFresh() const { return statusValid && getStatusAge() < STATUS_TTL; }
+
+    // longest time the modem wasn't served by the main loop, in microseconds
+    uint32_t getModemLoopGap() const { return sim900.getMaxLoopGap(); }
+    void resetModemLoopGap() { sim900.resetMaxLoopGap(); }
 
     // status LED
     LEDControl led{LED_PIN};
@@ -57,7 +112,70 @@ private:
     static constexpr char smsKey[] = "PROG";
 
     Sim900 sim900;
+
+    // outbound command scheduler, commands are held back until the modem is ready
+    // to send, arm/disarm requests take precedence over status requests:
+    // - only the latest arm/disarm request is kept
+    // - duplicate status requests are coalesced
+    // - a pending status request is dropped by an arm/disarm request,
+    //   the panel's confirmation reports the new state anyway
+    // - one command at a time, the next is sent after the panel confirmed the
+    //   previous one or COMMAND_TIMEOUT expired, status requests are coalesced with it
+    // - a command not confirmed within COMMAND_TIMEOUT tightens polling, after an arm/disarm
+    //   or a coalesced status request the state is requested again at once
+    struct PendingCommand {
+        bool valid = false;
+        Command cmd = Command::GetStatus;
+        uint16_t traceId = 0;
+        unsigned long queuedAt = 0;
+    };
+    PendingCommand pendingMode;     // arm/disarm
+    PendingCommand pendingStatus;   // status request
+    PendingCommand inFlight;        // sent, waiting for the panel's confirmation, queuedAt: time sent
+    bool statusCoalesced = false;   // status request coalesced with the command in flight
+    QueueStats queueStats;
+    EventStats eventStats;
+    void dispatchCommand();
+    bool transmitCommand(const PendingCommand &pending);
     FixedString128 currentStatus = FixedString128("N/A");
+    unsigned long statusUpdatedAt = 0;  // time of the last status received from the panel
+    bool statusValid = false;           // true once the panel reported a status
     unsigned long lastUpdate = 0;
+    template <size_t N>
+    void appendStatusFields(FixedString<N> &out) const;
+
+    // last panel message, published with the status as JSON attributes
+    SmsText messageText;                // message taken from the modem, parse buffer
+    uint16_t replyTrace = 0;            // command trace waiting for the panel's confirmation
+    SmsText lastSources = SmsText("N/A");
+    SmsText lastMessage = SmsText("N/A");
+    unsigned long messageTime = 0;      // time the last message was received, 0: none yet
+    uint16_t messageCount = 0;          // events represented by the last message
+    FixedString128 publishedStatus;     // status last written to the state topic
+    volatile unsigned long networkUpAt = 0;  // time WiFi got an IP, 0: no valid status pending
+    FixedString<3 * SMS_MAX_LENGTH> attributes;  // preallocated JSON attributes payload
+
+    // background status polling
+    unsigned long pollInterval = POLL_INTERVAL_MIN;
+    unsigned long pollTimer = 0;    // time of the last poll or status update
+    bool pollPending = false;   // status request sent, no status received since
+    void updateStatus(const FixedString128 &value, bool stablePoll);
+    void pollStatus();
+
+    // aggregation of bursty panel events
+    struct EventAggregate {
+        bool open = false;          // window started by a published event
+        unsigned long start = 0;    // window start
+        uint16_t count = 0;         // merged events, not yet published
+        unsigned long time = 0;     // time the latest merged event was received
+        FixedString128 status;      // latest status
+        SmsText sources;            // union of sources
+        SmsText message;            // latest message
+    };
+    EventAggregate aggregate;
+    SmsText eventSources;           // sources of the current message, comma separated
+    void applyEvent(const char* message, const char* sources, const FixedString128 &value,
+                    bool stablePoll, uint16_t count, unsigned long time);
+    void flushEvents();
 
 };
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FixedString.h"
+
+// max. length of an SMS body in bytes (UTF-8), a concatenated SMS of 4 parts with 153 characters each
+static constexpr size_t SMS_MAX_LENGTH = 4 * 153;
+
+// buffer large enough for a complete SMS body
+using SmsText = FixedString<SMS_MAX_LENGTH + 1>;
+
+// handle to an SMS body stored in the SmsArena, small enough to be passed through the queues
+struct SmsHandle {
+    static constexpr uint8_t NONE = 0xFF;
+    uint8_t head = NONE;    // first block
+    uint8_t tail = NONE;    // last block, appended to
+    uint16_t length = 0;    // total length in bytes
+    bool truncated = false; // text was dropped, counted once per body
+
+    bool valid() const { return head != NONE; }
+};
+
+/**
+ * @class SmsArena
+ * @brief Stores SMS bodies in a pool of fixed-size blocks, linked into a chain per body.
+ *
+ * Bodies grow block by block up to SMS_MAX_LENGTH without copying, the queues only
+ * hold a SmsHandle. Text which doesn't fit (body too long or no free block) is
+ * truncated, each truncated body is counted as overflow. Each handle must be
+ * released after use.
+ */
+class SmsArena {
+public:
+    static constexpr size_t BLOCK_SIZE = 32;
+    static constexpr size_t BLOCK_COUNT = 96;
+
+    SmsArena();
+
+    // append text to the body, allocates blocks as needed, returns false if truncated
+    bool append(SmsHandle &h, const char* s, size_t n);
+    bool append(SmsHandle &h, const char* s) { return append(h, s, strlen(s)); }
+    void release(SmsHandle &h);
+
+    // copy the body into a buffer, truncated to its size
+    size_t copy(const SmsHandle &h, char* out, size_t size) const;
+    template <size_t N>
+    size_t copy(const SmsHandle &h, FixedString<N> &out) const {
+        out.len = copy(h, out.buf, N);
+        return out.len;
+    }
+
+    // call f(const char* data, size_t len) for each block of the body
+    template <typename F>
+    void forEachChunk(const SmsHandle &h, F f) const {
+        size_t remaining = h.length;
+        for (uint8_t b = h.head; b != SmsHandle::NONE && remaining > 0; b = blocks[b].next) {
+            size_t n = remaining < BLOCK_SIZE ? remaining : BLOCK_SIZE;
+            f(blocks[b].data, n);
+            remaining -= n;
+        }
+    }
+
+    uint32_t getOverflows() const { return overflows; }
+    size_t getFreeBlocks() const { return freeCount; }
+
+private:
+    struct Block {
+        char data[BLOCK_SIZE];
+        uint8_t next;
+    };
+    Block blocks[BLOCK_COUNT];
+    uint8_t freeList = SmsHandle::NONE;
+    size_t freeCount = 0;
+    uint32_t overflows = 0;
+
+    uint8_t allocBlock();
+};
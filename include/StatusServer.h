@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FixedString.h"
+#include "Sim900Emulator.h"
+
+#ifdef NATIVE
+// on the host the endpoint is served on the loopback interface, e.g. for load tests
+static constexpr bool httpStatusEnabled = true;
+constexpr uint16_t HTTP_PORT = 8080;
+#else
+// toggles the local HTTP status endpoint, off by default: it serves the alarm state without authentication
+static constexpr bool httpStatusEnabled = false;
+constexpr uint16_t HTTP_PORT = 80;
+#endif
+
+/**
+ * @class StatusServer
+ * @brief Minimal HTTP endpoint serving the cached status and metrics as JSON.
+ *
+ * GET / or GET /status returns Emulator::renderSnapshot(), rendered into a preallocated
+ * buffer for each request, so local integrations can read the state without the MQTT
+ * broker and without a panel round trip. The server works on non-blocking sockets,
+ * no memory is allocated per request. Requests are read from loop(), at most MAX_CLIENTS
+ * connections are served at a time, further clients wait in the listen backlog.
+ * Connections are closed after the response or REQUEST_TIMEOUT, a response which
+ * doesn't fit into the send buffer is cut off instead of blocking.
+ */
+class StatusServer {
+public:
+    StatusServer(const Emulator &emulator, uint16_t port = HTTP_PORT)
+        : emulator(emulator), port(port) {};
+    void begin();
+    void loop();
+
+    uint32_t getRequests() const { return requests; }
+
+private:
+    static constexpr size_t MAX_CLIENTS = 2;
+    static constexpr uint32_t REQUEST_TIMEOUT = 1000;   // milliseconds
+    static constexpr size_t MAX_READ = 256;     // bytes read per connection and loop
+
+    struct Connection {
+        int fd = -1;
+        uint32_t start = 0;
+        FixedString<64> requestLine;    // e.g. "GET /status HTTP/1.1", longer lines are truncated
+        bool lineDone = false;
+        uint8_t newlines = 0;           // consecutive line ends, 2: end of header
+    };
+
+    const Emulator &emulator;
+    uint16_t port;
+    int listener = -1;
+    Connection connections[MAX_CLIENTS];
+    SnapshotText body;
+    uint32_t requests = 0;
+
+    void accept();
+    void serve(Connection &c);
+    void respond(Connection &c);
+    void send(Connection &c, const char* data, size_t length);
+    void close(Connection &c);
+};
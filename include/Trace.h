@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+// toggles recording of command traces
+static constexpr bool traceEnabled = true;
+
+/**
+ * @class Trace
+ * @brief Records the hops of a command request in a RAM ring buffer.
+ *
+ * A trace is started for each command sent to the alarm system, its id is passed along
+ * with the SMS through the modem buffers. Each hop is recorded with a time stamp, the
+ * time between two hops of the same trace is exported as span in Chrome trace-event
+ * JSON format (load into chrome://tracing or https://ui.perfetto.dev). The device dumps
+ * the spans over serial, the native build writes all spans in the ring to TRACE_FILE.
+ *
+ * Hops of an arm request:
+ *   Request -> Indicated (+CMTI) -> Read (+CMGR) -> Reply (+CMGS) -> Received (SMS body)
+ *   -> Parsed -> Published
+ */
+class Trace {
+public:
+    enum class Hop : uint8_t {
+        Request,    // command requested (HA button)
+        Indicated,  // SMS taken from the tx buffer, +CMTI sent to the panel
+        Read,       // panel read the SMS (+CMGR)
+        Reply,      // panel started its reply SMS (+CMGS)
+        Received,   // reply SMS body received
+        Parsed,     // reply taken from the rx buffer and parsed
+        Published   // status published via MQTT
+    };
+
+    static uint16_t begin();    // start a new trace, returns its id
+    static void hop(uint16_t id, Hop hop);
+    static void dump(Print &out, uint16_t id = 0);  // export as trace-event JSON, id 0: all traces
+#ifdef NATIVE
+    static constexpr const char* TRACE_FILE = "trace.json";
+    static bool save(const char* path = TRACE_FILE);   // replaces the file, false on error
+#endif
+
+private:
+    struct Event {
+        uint16_t id;
+        Hop hop;
+        uint32_t timestamp;  // microseconds
+    };
+
+    static constexpr size_t RING_SIZE = 64;
+    static Event ring[RING_SIZE];
+    static size_t head;     // next slot to write
+    static size_t count;
+    static uint16_t nextId;
+
+    static const char* spanName(Hop hop);
+    static void writeSpans(Print &out, uint16_t id);
+};
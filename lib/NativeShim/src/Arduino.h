@@ -0,0 +1,105 @@
+#pragma once
+
+// Minimal Arduino core for env:native: the subset of the Arduino and ESP32 API used by
+// the emulator, enough to run the benchmarks and unit tests on the host. There is no
+// hardware: pins and the modem UART are discarded, Serial writes to stdout.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+typedef uint8_t byte;
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define SERIAL_8N1 0x800001c
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+long random(long max);
+long random(long min, long max);
+uint32_t esp_random();
+
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) n += write(*buffer++);
+        return n;
+    }
+    size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+    size_t print(const char* str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(int value) { return print((long)value); }
+    size_t print(unsigned int value) { return print((unsigned long)value); }
+    size_t print(double value) { return printf("%.2f", value); }
+    size_t println(const char* str) { return print(str) + print("\r\n"); }
+    size_t println() { return print("\r\n"); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() { return -1; }
+};
+
+class IPAddress {
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    explicit IPAddress(uint32_t address) : address(address) {}
+    operator uint32_t() const { return address; }
+    uint8_t operator[](int index) const { return (address >> (index * 8)) & 0xff; }
+
+private:
+    uint32_t address = 0;   // network byte order, as on the ESP32
+};
+
+class HardwareSerial : public Stream {
+public:
+    explicit HardwareSerial(int uart) : uart(uart) {}
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {}
+    void end() {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(uint8_t c) override;
+    using Print::write;
+    operator bool() const { return true; }
+
+private:
+    int uart;   // 0: stdout, others are discarded
+};
+
+extern HardwareSerial Serial;
+
+// ESP.getCycleCount() counts nanoseconds, ESP.getCpuFreqMHz() reports 1000 accordingly
+class EspClass {
+public:
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 1000; }
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+};
+
+extern EspClass ESP;
+
+typedef void* TaskHandle_t;
+typedef unsigned int UBaseType_t;
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
@@ -0,0 +1,243 @@
+#include "ArduinoHA.h"
+
+HAMqtt* HAMqtt::current = nullptr;
+
+bool HABaseDeviceType::publishOnDataTopic(const char* topic, const char* payload, bool retained) {
+    HAMqtt* mqtt = HAMqtt::instance();
+    if (mqtt == nullptr || !mqtt->isConnected())
+        return false;
+    char fullTopic[128];
+    snprintf(fullTopic, sizeof(fullTopic), "aha/%s/%s", uniqueId, topic);
+    return mqtt->publish(fullTopic, payload, retained);
+}
+
+HAMqtt::HAMqtt(Client &client, HADevice &device, uint8_t maxDevicesTypesNb) : client(client) {
+    current = this;
+}
+
+bool HAMqtt::begin(IPAddress address, uint16_t port, const char* username, const char* password) {
+    if (initialized)
+        return false;
+    this->address = address;
+    this->port = port;
+    this->username = username;
+    this->password = password;
+    initialized = true;
+    return true;
+}
+
+bool HAMqtt::disconnect() {
+    if (!initialized)
+        return false;
+    initialized = false;
+    lastConnectionAttempt = 0;
+    if (connected)
+        writeHeader(0xE0, 0);   // DISCONNECT
+    connected = false;
+    client.stop();
+    return true;
+}
+
+void HAMqtt::loop() {
+    if (!initialized || clientLoop())
+        return;
+    // the client reconnects on its own, throttled as ArduinoHA
+    if (lastConnectionAttempt != 0 && millis() - lastConnectionAttempt < RECONNECT_INTERVAL)
+        return;
+    lastConnectionAttempt = millis();
+    connectToServer();
+}
+
+bool HAMqtt::connectToServer() {
+    // as PubSubClient: an open connection is used as is, otherwise the client connects
+    if (!client.connected() && client.connect(address, port) != 1)
+        return false;
+    static constexpr char clientId[] = "Sim900Emulator";
+    uint8_t flags = 0x02;   // clean session
+    size_t length = 10 + 2 + strlen(clientId);
+    if (username != nullptr) {
+        flags |= 0x80;
+        length += 2 + strlen(username);
+    }
+    if (password != nullptr) {
+        flags |= 0x40;
+        length += 2 + strlen(password);
+    }
+    const uint8_t variable[] = {0, 4, 'M', 'Q', 'T', 'T', 4, flags, (KEEP_ALIVE / 1000) >> 8, (KEEP_ALIVE / 1000) & 0xff};
+    if (!writeHeader(0x10, length) || client.write(variable, sizeof(variable)) != sizeof(variable) ||
+        !writeString(clientId) || (username != nullptr && !writeString(username)) ||
+        (password != nullptr && !writeString(password))) {
+        client.stop();
+        return false;
+    }
+    lastOutActivity = millis();
+    // wait for CONNACK
+    uint32_t start = millis();
+    while (!client.available()) {
+        if (millis() - start >= SOCKET_TIMEOUT) {
+            client.stop();
+            return false;
+        }
+    }
+    size_t packetLength = readPacket();
+    if (packetHeader == 0x20 && packetLength == 2 && buffer[1] == 0) {
+        connected = true;
+        pingOutstanding = false;
+        lastInActivity = millis();
+        return true;
+    }
+    client.stop();
+    return false;
+}
+
+// keep-alive and incoming packets, false if the session is lost
+bool HAMqtt::clientLoop() {
+    if (!connected)
+        return false;
+    if (!client.connected()) {
+        lost();
+        return false;
+    }
+    uint32_t now = millis();
+    if (now - lastInActivity > KEEP_ALIVE || now - lastOutActivity > KEEP_ALIVE) {
+        if (pingOutstanding) {
+            lost();
+            client.stop();
+            return false;
+        }
+        static constexpr uint8_t ping[] = {0xC0, 0};
+        client.write(ping, sizeof(ping));
+        lastOutActivity = now;
+        lastInActivity = now;
+        pingOutstanding = true;
+    }
+    if (!client.available())
+        return true;
+    size_t length = readPacket();
+    if (packetHeader == 0) {
+        if (!client.connected()) {
+            lost();
+            return false;
+        }
+        return true;
+    }
+    lastInActivity = millis();
+    switch (packetHeader & 0xF0) {
+        case 0x30: {    // PUBLISH
+            if (length > BUFFER_SIZE || length < 2 || messageCallback == nullptr)
+                break;
+            size_t topicLength = (buffer[0] << 8) | buffer[1];
+            size_t offset = 2 + topicLength + ((packetHeader & 0x06) != 0 ? 2 : 0);
+            if (offset > length)
+                break;
+            char topic[BUFFER_SIZE];
+            memcpy(topic, buffer + 2, topicLength);
+            topic[topicLength] = '\0';
+            messageCallback(topic, buffer + offset, length - offset);
+            break;
+        }
+        case 0xC0: {    // PINGREQ
+            static constexpr uint8_t pong[] = {0xD0, 0};
+            client.write(pong, sizeof(pong));
+            break;
+        }
+        case 0xD0:      // PINGRESP
+            pingOutstanding = false;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+void HAMqtt::lost() {
+    connected = false;
+}
+
+// waits for the next byte as PubSubClient, a failed read is taken as 0xff
+bool HAMqtt::readByte(uint8_t &c) {
+    uint32_t start = millis();
+    while (!client.available()) {
+        yield();
+        if (millis() - start >= SOCKET_TIMEOUT)
+            return false;
+    }
+    c = (uint8_t)client.read();
+    return true;
+}
+
+// reads a packet, returns its remaining length, the first BUFFER_SIZE bytes after the
+// fixed header are kept; packetHeader is 0 if the packet couldn't be read
+size_t HAMqtt::readPacket() {
+    uint8_t header;
+    packetHeader = 0;
+    if (!readByte(header))
+        return 0;
+    size_t length = 0;
+    uint32_t multiplier = 1;
+    uint8_t digit;
+    uint8_t count = 0;
+    do {
+        if (count++ == 4 || !readByte(digit))
+            return 0;   // malformed remaining length or timeout
+        length += (digit & 127) * multiplier;
+        multiplier <<= 7;
+    } while ((digit & 128) != 0);
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c;
+        if (!readByte(c))
+            return 0;
+        if (i < BUFFER_SIZE)
+            buffer[i] = c;
+    }
+    packetHeader = header;
+    return length;
+}
+
+bool HAMqtt::publish(const char* topic, const char* payload, bool retained) {
+    if (!connected)
+        return false;
+    size_t topicLength = strlen(topic);
+    size_t payloadLength = strlen(payload);
+    // header, topic and payload are written separately, as beginPublish(), write() and endPublish()
+    if (!writeHeader(retained ? 0x31 : 0x30, 2 + topicLength + payloadLength) || !writeString(topic) ||
+        client.write((const uint8_t*)payload, payloadLength) != payloadLength)
+        return false;
+    lastOutActivity = millis();
+    return true;
+}
+
+bool HAMqtt::subscribe(const char* topic) {
+    if (!connected)
+        return false;
+    uint16_t id = nextPacketId++;
+    if (nextPacketId == 0)
+        nextPacketId = 1;
+    const uint8_t packetId[] = {(uint8_t)(id >> 8), (uint8_t)(id & 0xff)};
+    static constexpr uint8_t qos = 0;
+    if (!writeHeader(0x82, 2 + 2 + strlen(topic) + 1) || client.write(packetId, 2) != 2 ||
+        !writeString(topic) || client.write(&qos, 1) != 1)
+        return false;
+    lastOutActivity = millis();
+    return true;
+}
+
+// fixed header: packet type and flags, remaining length
+bool HAMqtt::writeHeader(uint8_t type, size_t length) {
+    uint8_t header[5];
+    size_t n = 0;
+    header[n++] = type;
+    do {
+        uint8_t digit = length & 127;
+        length >>= 7;
+        header[n++] = length > 0 ? digit | 128 : digit;
+    } while (length > 0 && n < sizeof(header));
+    return client.write(header, n) == n;
+}
+
+// UTF-8 string with 16 bit length prefix
+bool HAMqtt::writeString(const char* s) {
+    size_t length = strlen(s);
+    const uint8_t prefix[] = {(uint8_t)(length >> 8), (uint8_t)(length & 0xff)};
+    return client.write(prefix, 2) == 2 && client.write((const uint8_t*)s, length) == length;
+}
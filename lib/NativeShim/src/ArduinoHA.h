@@ -0,0 +1,104 @@
+#pragma once
+
+// ArduinoHA API for env:native. HAMqtt is a minimal MQTT 3.1.1 client (QoS 0) which
+// uses its Client like ArduinoHA and PubSubClient do: it connects through the client
+// on its own, waits for CONNACK and the rest of a packet in a busy loop and keeps the
+// session alive with PINGREQ. Entities publish to aha/<unique id>/<topic>, discovery
+// configs are not published.
+
+#include "Arduino.h"
+#include "Client.h"
+
+class HADevice {
+public:
+    void setUniqueId(const byte* uniqueId, uint16_t length) {}
+    void setName(const char* name) {}
+    void setSoftwareVersion(const char* version) {}
+    void setManufacturer(const char* manufacturer) {}
+    void setAvailability(bool online) {}
+    void enableSharedAvailability() {}
+    void enableLastWill() {}
+};
+
+class HABaseDeviceType {
+public:
+    explicit HABaseDeviceType(const char* uniqueId) : uniqueId(uniqueId) {}
+    virtual ~HABaseDeviceType() = default;
+    void setName(const char* name) {}
+    const char* uniqueId;
+
+protected:
+    virtual void buildSerializer() {}
+    virtual void publishConfig() { buildSerializer(); }
+    bool publishOnDataTopic(const char* topic, const char* payload, bool retained);
+};
+
+class HASensor : public HABaseDeviceType {
+public:
+    enum Features {
+        DefaultFeatures = 0,
+        JsonAttributesFeature = 1
+    };
+    explicit HASensor(const char* uniqueId, uint16_t features = DefaultFeatures) : HABaseDeviceType(uniqueId) {}
+    bool setValue(const char* value, bool force = false) { return publishOnDataTopic("stat_t", value, true); }
+    bool setJsonAttributes(const char* json, bool force = false) { return publishOnDataTopic("json_attr_t", json, true); }
+    void setIcon(const char* icon) {}
+};
+
+class HAButton : public HABaseDeviceType {
+public:
+    explicit HAButton(const char* uniqueId) : HABaseDeviceType(uniqueId) {}
+    void setIcon(const char* icon) {}
+    void onCommand(void (*callback)(HAButton* sender)) {}
+};
+
+class HAMqtt {
+public:
+    HAMqtt(Client &client, HADevice &device, uint8_t maxDevicesTypesNb = 6);
+    static HAMqtt* instance() { return current; }
+
+    bool begin(IPAddress address, uint16_t port, const char* username = nullptr, const char* password = nullptr);
+    bool begin(IPAddress address, const char* username = nullptr, const char* password = nullptr) {
+        return begin(address, 1883, username, password);
+    }
+    bool disconnect();
+    void loop();
+    bool isConnected() const { return connected; }
+    bool publish(const char* topic, const char* payload, bool retained = false);
+    bool subscribe(const char* topic);
+    void onMessage(void (*callback)(const char* topic, const uint8_t* payload, uint16_t length)) {
+        messageCallback = callback;
+    }
+    const char* getDiscoveryPrefix() const { return "homeassistant"; }
+
+private:
+    static constexpr uint32_t RECONNECT_INTERVAL = 10000;  // milliseconds, as ArduinoHA
+    static constexpr uint32_t KEEP_ALIVE = 15000;          // milliseconds, as PubSubClient
+    static constexpr uint32_t SOCKET_TIMEOUT = 15000;      // milliseconds, as PubSubClient
+    static constexpr size_t BUFFER_SIZE = 256;             // incoming packets, larger ones are skipped
+
+    static HAMqtt* current;
+    Client &client;
+    IPAddress address;
+    uint16_t port = 1883;
+    const char* username = nullptr;
+    const char* password = nullptr;
+    bool initialized = false;
+    bool connected = false;
+    bool pingOutstanding = false;
+    uint32_t lastConnectionAttempt = 0;
+    uint32_t lastInActivity = 0;
+    uint32_t lastOutActivity = 0;
+    uint16_t nextPacketId = 1;
+    uint8_t packetHeader = 0;      // first byte of the last packet read, 0: none
+    uint8_t buffer[BUFFER_SIZE];   // rest of the last packet read
+    void (*messageCallback)(const char* topic, const uint8_t* payload, uint16_t length) = nullptr;
+
+    bool connectToServer();
+    bool clientLoop();
+    void lost();
+    bool readByte(uint8_t &c);
+    size_t readPacket();
+    bool writeHeader(uint8_t type, size_t length);
+    bool writeString(const char* s);
+};
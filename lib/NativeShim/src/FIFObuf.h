@@ -0,0 +1,38 @@
+#pragma once
+
+// FIFO ring buffer with the interface of the FIFObuf library
+
+#include <cstddef>
+
+template <typename T>
+class FIFObuf {
+public:
+    explicit FIFObuf(size_t capacity) : buffer(new T[capacity]), capacity(capacity) {}
+    ~FIFObuf() { delete[] buffer; }
+    FIFObuf(const FIFObuf&) = delete;
+    FIFObuf& operator=(const FIFObuf&) = delete;
+
+    bool push(const T &item) {
+        if (count == capacity)
+            return false;
+        buffer[(head + count) % capacity] = item;
+        count++;
+        return true;
+    }
+    T pop() {
+        T item = buffer[head];
+        head = (head + 1) % capacity;
+        count--;
+        return item;
+    }
+    size_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    bool isFull() const { return count == capacity; }
+    void clear() { head = count = 0; }
+
+private:
+    T* buffer;
+    size_t capacity;
+    size_t head = 0;
+    size_t count = 0;
+};
@@ -0,0 +1,220 @@
+#include "LoopbackBroker.h"
+#include "Arduino.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+bool LoopbackBroker::begin(uint16_t port) {
+    if (running)
+        return true;
+    this->port = port;
+    if (!listen())
+        return false;
+    running = true;
+    thread = std::thread(&LoopbackBroker::run, this);
+    return true;
+}
+
+void LoopbackBroker::end() {
+    if (!running)
+        return;
+    running = false;
+    thread.join();
+    closeAll();
+}
+
+void LoopbackBroker::record(const char* suffix) {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    snprintf(recordSuffix, sizeof(recordSuffix), "%s", suffix);
+    recordTimes.clear();
+}
+
+size_t LoopbackBroker::getRecorded() {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    return recordTimes.size();
+}
+
+uint32_t LoopbackBroker::getRecordedTime(size_t index) {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    return index < recordTimes.size() ? recordTimes[index] : 0;
+}
+
+void LoopbackBroker::sync() {
+    for (;;) {
+        if (mode != Mode::Up)
+            return;     // nothing is served
+        {
+            std::lock_guard<std::mutex> lock(serveMutex);
+            // loopback delivers sent data to the receive queue at once, it is handled
+            // when no session has unread data while the thread doesn't serve
+            bool pending = false;
+            for (auto &c : clients) {
+                int unread = 0;
+                if (ioctl(c.fd, FIONREAD, &unread) == 0 && unread > 0)
+                    pending = true;
+            }
+            int waiting = 0;
+            if (!pending && listener >= 0) {
+                struct pollfd fd = {listener, POLLIN, 0};
+                waiting = poll(&fd, 1, 0);
+            }
+            if (!pending && waiting <= 0)
+                return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool LoopbackBroker::listen() {
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener < 0)
+        return false;
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(listener, 4) < 0) {
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    return true;
+}
+
+void LoopbackBroker::closeAll() {
+    for (auto &c : clients)
+        close(c.fd);
+    clients.clear();
+    if (listener >= 0)
+        close(listener);
+    listener = -1;
+}
+
+void LoopbackBroker::run() {
+    while (running) {
+        Mode current = mode;
+        if (current == Mode::Down) {
+            closeAll();
+            usleep(1000);
+            continue;
+        }
+        if (listener < 0 && !listen()) {
+            usleep(1000);
+            continue;
+        }
+        if (current == Mode::Stall) {
+            usleep(1000);
+            continue;
+        }
+        std::vector<struct pollfd> fds;
+        fds.push_back({listener, POLLIN, 0});
+        for (auto &c : clients)
+            fds.push_back({c.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), 1) <= 0)
+            continue;
+        std::lock_guard<std::mutex> lock(serveMutex);
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0)
+                clients.push_back(Session{fd, {}});
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (fds[i].revents == 0)
+                continue;
+            Session &session = clients[i - 1];
+            if (!serve(session)) {
+                close(session.fd);
+                session.fd = -1;
+            }
+        }
+        for (size_t i = 0; i < clients.size(); ) {
+            if (clients[i].fd < 0)
+                clients.erase(clients.begin() + i);
+            else
+                ++i;
+        }
+    }
+}
+
+// reads available data and handles all complete packets, false: connection closed
+bool LoopbackBroker::serve(Session &session) {
+    uint8_t data[1024];
+    ssize_t n = recv(session.fd, data, sizeof(data), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        return false;
+    if (n > 0)
+        session.rx.insert(session.rx.end(), data, data + n);
+    for (;;) {
+        // fixed header: type, remaining length of up to 4 bytes
+        size_t length = 0;
+        size_t pos = 1;
+        uint32_t multiplier = 1;
+        bool complete = false;
+        while (pos < session.rx.size() && pos <= 4) {
+            uint8_t digit = session.rx[pos++];
+            length += (digit & 127) * multiplier;
+            multiplier <<= 7;
+            if ((digit & 128) == 0) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete) {
+            if (pos > 4)
+                return false;   // malformed
+            return true;        // wait for the rest of the header
+        }
+        if (session.rx.size() < pos + length)
+            return true;        // wait for the rest of the packet
+        bool ok = handle(session, session.rx[0], session.rx.data() + pos, length);
+        session.rx.erase(session.rx.begin(), session.rx.begin() + pos + length);
+        if (!ok)
+            return false;
+    }
+}
+
+bool LoopbackBroker::handle(Session &session, uint8_t header, const uint8_t* data, size_t length) {
+    switch (header & 0xF0) {
+        case 0x10: {    // CONNECT
+            static constexpr uint8_t connack[] = {0x20, 2, 0, 0};
+            sessions++;
+            return send(session.fd, connack, sizeof(connack), MSG_NOSIGNAL) == sizeof(connack);
+        }
+        case 0x30: {    // PUBLISH, QoS 0
+            publishes++;
+            if (length < 2)
+                return false;
+            size_t topicLength = (data[0] << 8) | data[1];
+            if (topicLength + 2 > length)
+                return false;
+            std::lock_guard<std::mutex> lock(recordMutex);
+            size_t suffixLength = strlen(recordSuffix);
+            if (suffixLength > 0 && topicLength >= suffixLength &&
+                memcmp(data + 2 + topicLength - suffixLength, recordSuffix, suffixLength) == 0)
+                recordTimes.push_back(millis());
+            return true;
+        }
+        case 0x80: {    // SUBSCRIBE, granted with QoS 0
+            if (length < 2)
+                return false;
+            const uint8_t suback[] = {0x90, 3, data[0], data[1], 0};
+            return send(session.fd, suback, sizeof(suback), MSG_NOSIGNAL) == sizeof(suback);
+        }
+        case 0xC0: {    // PINGREQ
+            static constexpr uint8_t pingresp[] = {0xD0, 0};
+            return send(session.fd, pingresp, sizeof(pingresp), MSG_NOSIGNAL) == sizeof(pingresp);
+        }
+        case 0xE0:      // DISCONNECT
+            return false;
+        default:
+            return true;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// MQTT broker stand-in for env:native on 127.0.0.1, served by its own thread.
+// It answers CONNECT, SUBSCRIBE and PINGREQ, counts PUBLISH (QoS 0) and records the
+// receipt time of publishes to a topic suffix. The mode simulates broker outages.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class LoopbackBroker {
+public:
+    enum class Mode : uint8_t {
+        Up,         // sessions are accepted
+        Down,       // connections are refused, open ones closed
+        Stall       // TCP connections are accepted by the kernel, nothing is read or answered
+    };
+
+    static constexpr uint16_t PORT = 18830;
+
+    ~LoopbackBroker() { end(); }
+    bool begin(uint16_t port = PORT);
+    void end();
+
+    void setMode(Mode mode) { this->mode = mode; }
+    // waits until all data sent to the broker was handled, for loops on the virtual clock
+    // which run faster than the broker thread answers
+    void sync();
+    uint32_t getSessions() const { return sessions; }     // CONNECT packets accepted
+    uint32_t getPublishes() const { return publishes; }
+
+    // receipt times (millis()) of publishes to topics ending with suffix, replaces the recorded times
+    void record(const char* suffix);
+    size_t getRecorded();
+    uint32_t getRecordedTime(size_t index);
+
+private:
+    struct Session {
+        int fd;
+        std::vector<uint8_t> rx;
+    };
+
+    uint16_t port = PORT;
+    int listener = -1;
+    std::vector<Session> clients;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<Mode> mode{Mode::Up};
+    std::atomic<uint32_t> sessions{0};
+    std::atomic<uint32_t> publishes{0};
+    std::mutex serveMutex;     // held while the thread serves the sessions
+    std::mutex recordMutex;
+    char recordSuffix[32] = "";
+    std::vector<uint32_t> recordTimes;
+
+    bool listen();
+    void closeAll();
+    void run();
+    bool serve(Session &session);
+    bool handle(Session &session, uint8_t header, const uint8_t* data, size_t length);
+};
@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+
+// clock of millis() and micros(), real time by default; while virtual, time only advances
+// with advance() and delay(), so simulated days run in seconds (ESP.getCycleCount() stays real)
+namespace NativeClock {
+void setVirtual(bool enabled);
+void advance(uint32_t ms);
+}
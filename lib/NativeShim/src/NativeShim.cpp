@@ -0,0 +1,192 @@
+#include "Arduino.h"
+#include "WiFi.h"
+#include "esp_timer.h"
+#include "NativeClock.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+HardwareSerial Serial(0);
+EspClass ESP;
+WiFiClass WiFi;
+
+static const auto startTime = std::chrono::steady_clock::now();
+
+static uint64_t elapsedNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// read by the loopback broker thread as well
+static std::atomic<bool> virtualClock{false};
+static std::atomic<uint64_t> virtualNanos{0};
+static std::atomic<int64_t> clockOffset{0};    // nanoseconds, keeps the clock monotonic across switches
+
+static uint64_t clockNanos() {
+    return virtualClock ? virtualNanos.load() : elapsedNanos() + clockOffset;
+}
+
+void NativeClock::setVirtual(bool enabled) {
+    if (enabled == virtualClock)
+        return;
+    if (enabled)
+        virtualNanos = elapsedNanos() + clockOffset;
+    else
+        clockOffset = virtualNanos - elapsedNanos();
+    virtualClock = enabled;
+}
+
+void NativeClock::advance(uint32_t ms) {
+    virtualNanos += (uint64_t)ms * 1000000;
+}
+
+unsigned long millis() {
+    return clockNanos() / 1000000;
+}
+
+unsigned long micros() {
+    return clockNanos() / 1000;
+}
+
+void delay(unsigned long ms) {
+    if (virtualClock) {
+        NativeClock::advance(ms);
+        return;
+    }
+    unsigned long start = millis();
+    while (millis() - start < ms) {}
+}
+
+void yield() {}
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+
+long random(long max) {
+    return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max) {
+    return min + random(max - min);
+}
+
+uint32_t esp_random() {
+    return (uint32_t)rand();
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[64];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return n > 0 ? write(buffer) : 0;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (uart == 0)
+        putchar(c);
+    return 1;
+}
+
+uint32_t EspClass::getCycleCount() {
+    return (uint32_t)elapsedNanos();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 0;
+}
+
+struct esp_timer {};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    static esp_timer timer;
+    *handle = &timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    return ESP_OK;
+}
+
+void WiFiServer::begin() {
+    end();
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, maxClients) < 0) {
+        end();
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+void WiFiServer::end() {
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+WiFiClient WiFiServer::accept() {
+    // the accepted socket doesn't inherit O_NONBLOCK
+    return WiFiClient(fd < 0 ? -1 : ::accept(fd, nullptr, nullptr));
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    return 0;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    if (fd < 0)
+        return 0;
+    ssize_t n = send(fd, buffer, size, MSG_NOSIGNAL);
+    return n > 0 ? n : 0;
+}
+
+int WiFiClient::available() {
+    uint8_t buffer[64];
+    ssize_t n = fd < 0 ? 0 : recv(fd, buffer, sizeof(buffer), MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 ? n : 0;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    ssize_t n = fd < 0 ? -1 : recv(fd, buffer, size, MSG_DONTWAIT);
+    return n > 0 ? n : -1;
+}
+
+int WiFiClient::peek() {
+    uint8_t c;
+    return fd >= 0 && recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+void WiFiClient::stop() {
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+uint8_t WiFiClient::connected() {
+    if (fd < 0)
+        return 0;
+    uint8_t c;
+    ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
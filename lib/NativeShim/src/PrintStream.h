@@ -0,0 +1,21 @@
+#pragma once
+
+// stream insertion operators of the PrintStream library, decimal output only
+
+#include "Arduino.h"
+
+inline Print &operator<<(Print &p, const char* s) { p.print(s); return p; }
+inline Print &operator<<(Print &p, char c) { p.print(c); return p; }
+inline Print &operator<<(Print &p, bool b) { p.print(b ? "true" : "false"); return p; }
+inline Print &operator<<(Print &p, int v) { p.print(v); return p; }
+inline Print &operator<<(Print &p, unsigned int v) { p.print(v); return p; }
+inline Print &operator<<(Print &p, long v) { p.print(v); return p; }
+inline Print &operator<<(Print &p, unsigned long v) { p.print(v); return p; }
+inline Print &operator<<(Print &p, long long v) { p.printf("%lld", v); return p; }
+inline Print &operator<<(Print &p, unsigned long long v) { p.printf("%llu", v); return p; }
+inline Print &operator<<(Print &p, double v) { p.print(v); return p; }
+inline Print &operator<<(Print &p, const IPAddress &ip) {
+    p.printf("%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return p;
+}
+inline Print &operator<<(Print &p, Print &(*manipulator)(Print &)) { return manipulator(p); }
@@ -0,0 +1,82 @@
+#pragma once
+
+// WiFi API for env:native: the station state is set by the host program (setStatus),
+// clients and servers work on plain sockets
+
+#include "Arduino.h"
+#include "Client.h"
+
+typedef int WiFiEvent_t;
+enum : WiFiEvent_t {
+    ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5
+};
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 };
+enum wifi_mode_t { WIFI_OFF = 0, WIFI_STA = 1 };
+
+class WiFiClient : public Client {
+public:
+    WiFiClient() = default;
+    explicit WiFiClient(int fd) : fd(fd) {}
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override { return 0; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return fd >= 0; }
+    void setTimeout(uint32_t seconds) {}
+    void setNoDelay(bool noDelay) {}
+
+private:
+    int fd = -1;    // copies share the socket, as on the ESP32
+};
+
+// listens on the loopback interface, accept() doesn't block
+class WiFiServer {
+public:
+    WiFiServer(uint16_t port = 80, uint8_t maxClients = 4) : port(port), maxClients(maxClients) {}
+    void begin();
+    void end();
+    void setNoDelay(bool noDelay) {}
+    WiFiClient accept();
+    WiFiClient available() { return accept(); }
+    operator bool() { return fd >= 0; }
+
+private:
+    uint16_t port;
+    uint8_t maxClients;
+    int fd = -1;
+};
+
+class WiFiClass {
+public:
+    template <typename Handler>
+    void onEvent(Handler handler) {}
+    wl_status_t begin(const char* ssid, const char* password) { return WL_DISCONNECTED; }
+    bool mode(wifi_mode_t mode) { return true; }
+    bool disconnect() { return true; }
+    bool reconnect() { return false; }
+    bool setSleep(bool enabled) { return true; }
+    wl_status_t status() { return stationStatus; }
+    // host only: simulated station state
+    void setStatus(wl_status_t status) { stationStatus = status; }
+    int16_t scanNetworks() { return 0; }
+    const char* SSID(uint8_t index = 0) { return ""; }
+    IPAddress localIP() { return IPAddress(); }
+    uint8_t* macAddress(uint8_t* mac) {
+        memset(mac, 0, 6);
+        return mac;
+    }
+
+private:
+    wl_status_t stationStatus = WL_DISCONNECTED;
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,12 @@
+#pragma once
+
+// lwip provides the BSD socket API on the ESP32, the host has it natively
+
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
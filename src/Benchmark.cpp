@@ -0,0 +1,567 @@
+#ifdef BENCHMARK
+
+#include "Benchmark.h"
+#include "Sim900Emulator.h"
+#include "DebugInterface.h"
+#include "BenchmarkBaseline.h"
+#include "ConnectionManager.h"
+#include <algorithm>
+#ifdef NATIVE
+#include <NativeClock.h>
+#include <LoopbackBroker.h>
+#include <WiFi.h>
+#endif
+
+// debug output module identifier
+static inline Print& beginl(Print &stream) {
+    static constexpr const char name[] = "BENCH";
+    return beginl<name>(stream);
+}
+
+extern Emulator emulator;
+extern HAMqtt mqtt;
+extern ConnectionManager network;
+#ifdef NATIVE
+extern void loop();
+// the emulator publishes to the broker stand-in, the storm latency ends at its receipt
+static LoopbackBroker broker;
+#endif
+
+template <typename T>
+static void drain(FIFObuf<T> &buf) {
+    while (buf.size() > 0) buf.pop();
+}
+
+Benchmark::Result Benchmark::results[Benchmark::MAX_RESULTS];
+size_t Benchmark::resultCount = 0;
+Benchmark::StormResult Benchmark::stormResults[sizeof(STORM_RATES) / sizeof(STORM_RATES[0])];
+Benchmark::SoakResult Benchmark::soak;
+uint16_t Benchmark::soakHistogram[Benchmark::SOAK_BUCKETS];
+
+template <typename Prepare, typename Body>
+void Benchmark::measure(const char* name, uint32_t iterations, Prepare prepare, Body body) {
+    if (resultCount >= MAX_RESULTS) {
+        Serial << beginl << red << "Result table full, skipping: " << name << DI::endl;
+        return;
+    }
+    Result &r = results[resultCount++];
+    r = Result{name, iterations, 0, UINT32_MAX, 0};
+    for (uint32_t i = 0; i < iterations; ++i) {
+        prepare();
+        uint32_t start = ESP.getCycleCount();
+        body();
+        uint32_t cycles = ESP.getCycleCount() - start;
+        r.cycles += cycles;
+        if (cycles < r.minCycles) r.minCycles = cycles;
+        if (cycles > r.maxCycles) r.maxCycles = cycles;
+    }
+}
+
+void Benchmark::run() {
+    Serial << beginl << "Running benchmarks, CPU " << ESP.getCpuFreqMHz() << " MHz" << DI::endl;
+    resultCount = 0;
+    benchFixedString();
+    benchCharset();
+    benchDispatch();
+    benchSplitCommands();
+    benchMessageParser();
+    benchPanelSession();
+    benchLed();
+    report();
+}
+
+void Benchmark::benchFixedString() {
+    static constexpr uint32_t N = 1000;
+    static constexpr char text[] = "BW Wohnzimmer|Einbruch|BW Kueche|Einbruch";
+    FixedString128 fs;
+    auto none = [] {};
+
+    measure("fixedstring_set", N, none, [&] { fs.set(text); });
+    measure("fixedstring_append", N, [&] { fs.clear(); }, [&] {
+        fs.append("PROG");
+        fs.append(' ');
+        fs.append("1207");
+        fs.append(" MOD?:");
+    });
+    measure("fixedstring_trim", N, [&] { fs.set("   +CMGS=\"+4915773807779\"   "); }, [&] { fs.trim(); });
+    measure("fixedstring_remove", N, [&] { fs.set("AT+CMGR=1"); }, [&] { fs.remove(0, 2); });
+}
+
+void Benchmark::benchCharset() {
+    static constexpr uint32_t N = 1000;
+    // "BW Küche|Einbruch" in the host character sets
+    static constexpr char gsm[] = "BW K\x7e" "che\nEinbruch";
+    static constexpr char ucs2[] = "00420057004B00FC006300680065000A00450069006E006200720075006300680020";
+    static constexpr char utf8[] = "PROG 1207 MODE:A Küche";
+    FixedString128 fs;
+    auto reset = [&] { fs.clear(); };
+
+    measure("charset_decode_gsm", N, reset, [&] { Charset::decode(Charset::Type::GSM, gsm, fs); });
+    measure("charset_decode_ucs2", N, reset, [&] { Charset::decode(Charset::Type::UCS2, ucs2, fs); });
+    measure("charset_encode_gsm", N, reset, [&] { Charset::encode(Charset::Type::GSM, utf8, fs); });
+    measure("charset_encode_ucs2", N, reset, [&] { Charset::encode(Charset::Type::UCS2, utf8, fs); });
+}
+
+// LED patterns are played by the timer task, the main loop only pays for state changes
+void Benchmark::benchLed() {
+    static constexpr uint32_t N = 1000;
+    LEDControl &led = emulator.led;
+    auto none = [] {};
+
+    measure("led_tick", N, none, [&] { led.tick(); });
+    measure("led_indicate", N, none, [&] { led.indicate(3); });
+    measure("led_set_state", N, none, [&] { led.setState(LEDControl::LedState::LED_ON); });
+}
+
+void Benchmark::benchDispatch() {
+    static constexpr uint32_t N = 1000;
+    Sim900 &sim = emulator.sim900;
+    auto none = [] {};
+    const Script* volatile script = nullptr;
+
+    // first, last and unmatched entry of the command table
+    measure("dispatch_at", N, none, [&] { script = sim.findScript("AT"); });
+    measure("dispatch_creg", N, none, [&] { script = sim.findScript("+CREG?"); });
+    measure("dispatch_unknown", N, none, [&] { script = sim.findScript("+CMGR=1"); });
+    (void)script;
+}
+
+void Benchmark::benchSplitCommands() {
+    static constexpr uint32_t N = 100;
+    Sim900 &sim = emulator.sim900;
+
+    // note: includes the debug output of the received line
+    measure("split_commands", N, [&] {
+        drain(sim.commands);
+        sim.rxBuffer.set("AT+CMGF=1; +CNMI=3,1; +CSCS=\"GSM\"; +CMGDA=\"DEL ALL\"");
+    }, [&] { sim.splitCommands(); });
+    drain(sim.commands);
+}
+
+void Benchmark::benchMessageParser() {
+    static constexpr uint32_t N = 20;
+    Sim900 &sim = emulator.sim900;
+
+    // note: includes the MQTT publish calls and debug output
+    measure("message_parser", N, [&] {
+        sim.clearMessages(sim.msgRxBuffer);
+        sim.pushMessage(sim.msgRxBuffer, "BW Wohnzimmer|Einbruch|BW Kueche|Einbruch", 0);
+    }, [&] { emulator.loop(); });
+}
+
+// feed a line from the panel, in SMS mode '|' separates the body lines (textEnd: terminated by Ctrl+Z)
+void Benchmark::feed(const char* line, bool textEnd) {
+    Sim900 &sim = emulator.sim900;
+    if (!sim.receiveSMS) {
+        sim.rxBuffer.set(line);
+        sim.splitCommands();
+        return;
+    }
+    while (true) {
+        const char* sep = strchr(line, '|');
+        size_t n = sep ? (size_t)(sep - line) : strlen(line);
+        sim.rxBuffer.clear();
+        for (size_t i = 0; i < n; ++i) sim.rxBuffer.append(line[i]);
+        if (sep == nullptr) {
+            sim.receiveSmsLine(textEnd);
+            break;
+        }
+        sim.receiveSmsLine(false);
+        line = sep + 1;
+    }
+}
+
+// run the emulator until all commands and responses are processed,
+// returns the elapsed time in milliseconds and records the cycles of each loop() call
+uint32_t Benchmark::runUntilIdle(Result &r) {
+    static constexpr uint32_t TIMEOUT = 10000;
+    uint32_t start = millis();
+    while (millis() - start < TIMEOUT) {
+        uint32_t c = ESP.getCycleCount();
+        emulator.loop();
+        uint32_t cycles = ESP.getCycleCount() - c;
+        r.iterations++;
+        r.cycles += cycles;
+        if (cycles < r.minCycles) r.minCycles = cycles;
+        if (cycles > r.maxCycles) r.maxCycles = cycles;
+        if (isIdle())
+            break;
+    }
+    return millis() - start;
+}
+
+// all commands, responses and messages processed
+bool Benchmark::isIdle() {
+    Sim900 &sim = emulator.sim900;
+    return sim.state == Sim900::ModemState::Idle && sim.commands.size() == 0 &&
+           sim.response.size() == 0 && sim.msgTxBuffer.size() == 0 && sim.msgRxBuffer.size() == 0 &&
+           !emulator.pendingMode.valid && !emulator.pendingStatus.valid;
+}
+
+void Benchmark::benchPanelSession() {
+    if (resultCount >= MAX_RESULTS)
+        return;
+    Sim900 &sim = emulator.sim900;
+    // iterations: number of loop() calls during the whole session
+    Result &r = results[resultCount++];
+    r = Result{"panel_session", 0, 0, UINT32_MAX, 0};
+    uint32_t elapsed = 0;
+
+    // init
+    sim.commands.push(FixedString128("ATZ"));
+    elapsed += runUntilIdle(r);
+    feed("AT+CMGF=1; +CNMI=3,1; +CSCS=\"GSM\"");
+    elapsed += runUntilIdle(r);
+    // status request sent at startup, the next command waits for its confirmation
+    if (sim.smsTx.valid()) {
+        feed("AT+CMGR=1");
+        elapsed += runUntilIdle(r);
+        feed("AT+CMGS=\"+4915773807779\"");
+        elapsed += runUntilIdle(r);
+        feed("Confirmed|PROG 1207 MOD?:D", true);
+        elapsed += runUntilIdle(r);
+    }
+    // alarm SMS
+    feed("AT+CMGS=\"+4915773807779\"");
+    elapsed += runUntilIdle(r);
+    feed("BW Flur|Einbruch", true);
+    elapsed += runUntilIdle(r);
+    // arm / disarm round trip
+    static constexpr Emulator::Command cmds[] = {Emulator::Command::ArmAway, Emulator::Command::Disarm};
+    static constexpr const char* confirm[] = {"Confirmed|PROG 1207 MODE:A", "Confirmed|PROG 1207 MODE:D"};
+    for (size_t i = 0; i < 2; ++i) {
+        emulator.sendCommand(cmds[i]);
+        elapsed += runUntilIdle(r);  // +CMTI
+        feed("AT+CMGR=1");
+        elapsed += runUntilIdle(r);
+        feed("AT+CMGS=\"+4915773807779\"");
+        elapsed += runUntilIdle(r);
+        feed(confirm[i], true);
+        elapsed += runUntilIdle(r);
+    }
+    Serial << beginl << "Panel session finished after " << elapsed << " ms" << DI::endl;
+}
+
+void Benchmark::report() {
+    Serial << "BENCH_JSON {\"version\":\"" << VERSION << "\",\"cpu_mhz\":" << ESP.getCpuFreqMHz() << ",\"results\":[";
+    for (size_t i = 0; i < resultCount; ++i) {
+        const Result &r = results[i];
+        if (i > 0) Serial << ",";
+        Serial << "{\"name\":\"" << r.name << "\",\"iterations\":" << r.iterations
+               << ",\"cycles_avg\":" << (uint32_t)(r.iterations ? r.cycles / r.iterations : 0)
+               << ",\"cycles_min\":" << r.minCycles << ",\"cycles_max\":" << r.maxCycles << "}";
+    }
+    Serial << "]}\n";
+}
+
+void Benchmark::runEventStorm() {
+    static constexpr size_t STAGES = sizeof(STORM_RATES) / sizeof(STORM_RATES[0]);
+    Serial << beginl << "Running event storm" << DI::endl;
+    for (size_t i = 0; i < STAGES; ++i) {
+        stormResults[i] = StormResult{STORM_RATES[i], 0, 0, 0, 0, 0, {0, 0, 0, 0}};
+        runStormStage(stormResults[i]);
+    }
+    Serial << "BENCH_JSON {\"version\":\"" << VERSION << "\",\"event_storm\":[";
+    for (size_t i = 0; i < STAGES; ++i) {
+        const StormResult &r = stormResults[i];
+        if (i > 0) Serial << ",";
+        Serial << "{\"rate\":" << r.rate << ",\"injected\":" << r.injected << ",\"published\":" << r.published
+#ifdef NATIVE
+               << ",\"delivered\":" << r.delivered
+#endif
+               << ",\"merged\":" << r.merged
+               << ",\"dropped\":" << r.dropped
+               << ",\"publish_per_s\":" << (float)r.published * 1000 / STORM_STAGE_DURATION
+               << ",\"latency_p50\":" << r.latency[0] << ",\"latency_p90\":" << r.latency[1]
+               << ",\"latency_p99\":" << r.latency[2] << ",\"latency_max\":" << r.latency[3] << "}";
+    }
+    Serial << "]}\n";
+}
+
+// the simulated panel delivers alarm SMS at the stage rate into the modem's message buffer,
+// independent of the modem state (an SMS exchange takes several 100 ms, the panel would be
+// limited to a few events per second), events are dropped when the buffer is full,
+// the latency covers parsing, aggregation and publishing, on the host up to the receipt
+// of the attributes publish by the broker stand-in
+void Benchmark::runStormStage(StormResult &r) {
+    static constexpr const char* events[] = {
+        "BW Flur|Einbruch",
+        "BW Wohnzimmer|Einbruch|BW Kueche|Einbruch",
+        "TK Haustuer|Einbruch"
+    };
+    static_assert(STORM_RATES[sizeof(STORM_RATES) / sizeof(STORM_RATES[0]) - 1] * STORM_STAGE_DURATION / 1000
+                  <= STORM_MAX_SAMPLES, "STORM_MAX_SAMPLES too small for the fastest stage");
+    static uint32_t samples[STORM_MAX_SAMPLES];
+    static uint32_t injectedAt[STORM_MAX_SAMPLES];  // injection time of events in the message buffer
+#ifdef NATIVE
+    static size_t samplePublish[STORM_MAX_SAMPLES];  // publish of the stage covering the event
+    broker.record("/json_attr_t");
+#endif
+    size_t sampleCount = 0;
+    size_t head = 0;            // oldest unpublished event
+    size_t accepted = 0;        // events stored in the message buffer
+
+    Sim900 &sim = emulator.sim900;
+    const uint32_t interval = 1000 / r.rate;
+    const Emulator::EventStats statsBefore = emulator.getEventStats();
+    uint32_t covered = statsBefore.messages;    // events published so far, also as part of an aggregate
+    uint32_t start = millis();
+    uint32_t end = start + STORM_STAGE_DURATION;
+
+    // run until the stage duration is over and all accepted events are processed
+    while ((int32_t)(millis() - end) < 0 || head < accepted) {
+        uint32_t now = millis();
+        if ((int32_t)(now - end) > (int32_t)STORM_STAGE_DURATION)
+            break;  // emulator can't keep up, give up
+        // deliver all events due by now, a slow loop() gets them as a burst
+        while ((int32_t)(now - end) < 0 && now - start >= r.injected * interval) {
+            if (sim.pushMessage(sim.msgRxBuffer, events[r.injected % 3], 0))
+                injectedAt[accepted++] = now;
+            else
+                r.dropped++;
+            r.injected++;
+        }
+        network.loop();
+        emulator.loop();
+        // match publishes with the oldest accepted event
+        uint32_t current = emulator.getEventStats().messages - emulator.aggregate.count;
+        while (covered < current) {
+            covered++;
+            if (head < accepted) {
+#ifdef NATIVE
+                samplePublish[sampleCount] = emulator.getEventStats().published - statsBefore.published - 1;
+                samples[sampleCount++] = injectedAt[head++];
+#else
+                samples[sampleCount++] = millis() - injectedAt[head++];
+#endif
+            }
+        }
+    }
+    r.published = emulator.getEventStats().published - statsBefore.published;
+    r.merged = emulator.getEventStats().merged - statsBefore.merged;
+#ifdef NATIVE
+    // each status publish writes the attributes once, the broker records them in order
+    uint32_t drainStart = millis();
+    while (broker.getRecorded() < r.published && millis() - drainStart < 1000) {}
+    r.delivered = broker.getRecorded();
+    size_t delivered = 0;
+    for (size_t i = 0; i < sampleCount; ++i) {
+        if (samplePublish[i] < r.delivered)
+            samples[delivered++] = broker.getRecordedTime(samplePublish[i]) - samples[i];
+    }
+    sampleCount = delivered;
+#endif
+    if (sampleCount > 0) {
+        std::sort(samples, samples + sampleCount);
+        r.latency[0] = samples[sampleCount * 50 / 100];
+        r.latency[1] = samples[sampleCount * 90 / 100];
+        r.latency[2] = samples[sampleCount * 99 / 100];
+        r.latency[3] = samples[sampleCount - 1];
+    }
+    Serial << beginl << "Storm stage " << r.rate << "/s: injected " << r.injected << ", published " << r.published
+#ifdef NATIVE
+           << ", delivered " << r.delivered
+#endif
+           << ", merged " << r.merged << ", dropped " << r.dropped << DI::endl;
+}
+
+bool Benchmark::runSoak() {
+    static constexpr uint32_t TICKS = SOAK_DAYS * 24 * 60 / SOAK_TICK;
+    static constexpr const char* alarms[] = {
+        "BW Flur|Einbruch",
+        "BW Wohnzimmer|Einbruch|BW Kueche|Einbruch",
+        "TK Haustuer|Sabotage"
+    };
+    Serial << beginl << "Running soak test, " << SOAK_DAYS << " simulated days" << DI::endl;
+    soak = SoakResult{0, 0, {0, 0, 0}, 0, 0, 0, 0, UINT32_MAX, UINT32_MAX};
+    memset(soakHistogram, 0, sizeof(soakHistogram));
+    bool armed = false;
+#ifdef NATIVE
+    NativeClock::setVirtual(true);
+#endif
+    uint32_t start = millis();
+
+    // panel init
+    soakExchange("ATZ");
+    soakExchange("AT+CMGF=1; +CNMI=3,1; +CSCS=\"GSM\"");
+    for (uint32_t tick = 0; tick < TICKS; ++tick) {
+        uint32_t tickStart = millis();
+        soakExchange("AT+CSQ");
+        soakExchange("AT+CREG?");
+        if (tick % SOAK_ALARM_TICKS == SOAK_ALARM_TICKS - 1) {
+            soakExchange("AT+CMGS=\"+4915773807779\"");
+            soakExchange(alarms[(tick / SOAK_ALARM_TICKS) % 3], true);
+        }
+        if (tick % SOAK_COMMAND_TICKS == SOAK_COMMAND_TICKS / 2)
+            emulator.sendCommand(armed ? Emulator::Command::Disarm : Emulator::Command::ArmAway);
+        // commands from HA and the background status polls are read and confirmed by the panel
+        soakServeCommand(armed);
+        soakIdle(tickStart + SOAK_TICK * 60000, armed);
+    }
+
+    soak.latency[0] = soakPercentile(50);
+    soak.latency[1] = soakPercentile(99);
+    Serial << beginl << "Soak test finished after " << (millis() - start) / 1000 << " s, "
+           << soak.exchanges << " exchanges" << DI::endl;
+#ifdef NATIVE
+    NativeClock::setVirtual(false);
+#endif
+
+    bool pass = true;
+#ifdef NATIVE
+    // LOOP_ALLOWANCE is not recorded on the device yet, there the latencies are only reported
+    pass &= soakCheck("latency_p50", soak.latency[0], Baseline::latencyP50);
+    pass &= soakCheck("latency_p99", soak.latency[1], Baseline::latencyP99);
+    pass &= soakCheck("latency_max", soak.latency[2], Baseline::latencyMax);
+#endif
+    pass &= soakCheck("timeouts", soak.timeouts, Baseline::timeouts);
+    pass &= soakCheck("command_depth", soak.commandDepth, Baseline::commandDepth);
+    pass &= soakCheck("response_depth", soak.responseDepth, Baseline::responseDepth);
+    pass &= soakCheck("message_depth", soak.messageDepth, Baseline::messageDepth);
+    pass &= soakCheck("arena_blocks", soak.arenaBlocks, Baseline::arenaBlocks);
+#ifndef NATIVE
+    // the host has no heap and stack figures
+    pass &= soakCheck("min_free_heap", soak.minFreeHeap, Baseline::minFreeHeap, true);
+    pass &= soakCheck("min_free_stack", soak.minFreeStack, Baseline::minFreeStack, true);
+#endif
+
+    Serial << "BENCH_JSON {\"version\":\"" << VERSION << "\",\"soak\":{\"days\":" << SOAK_DAYS
+           << ",\"exchanges\":" << soak.exchanges << ",\"timeouts\":" << soak.timeouts
+           << ",\"latency_p50\":" << soak.latency[0] << ",\"latency_p99\":" << soak.latency[1]
+           << ",\"latency_max\":" << soak.latency[2]
+           << ",\"command_depth\":" << soak.commandDepth << ",\"response_depth\":" << soak.responseDepth
+           << ",\"message_depth\":" << soak.messageDepth << ",\"arena_blocks\":" << soak.arenaBlocks
+           << ",\"min_free_heap\":" << soak.minFreeHeap << ",\"min_free_stack\":" << soak.minFreeStack
+           << ",\"pass\":" << (pass ? "true" : "false") << "}}\n";
+    Serial << "SOAK_RESULT " << (pass ? "PASS" : "FAIL") << "\n";
+    return pass;
+}
+
+// feed a line from the panel and run the emulator until it is processed,
+// the time until the response is complete is recorded as latency
+void Benchmark::soakExchange(const char* line, bool textEnd) {
+    uint32_t start = millis();
+    feed(line, textEnd);
+    bool idle = false;
+    while (!idle && millis() - start < SOAK_TIMEOUT) {
+        soakLoop(1);
+        idle = isIdle();
+    }
+    soak.exchanges++;
+    if (!idle) {
+        soak.timeouts++;
+        Serial << beginl << red << "Soak exchange timed out: " << line << DI::endl;
+        return;
+    }
+    uint32_t latency = millis() - start;
+    size_t bucket = latency / SOAK_BUCKET;
+    soakHistogram[bucket < SOAK_BUCKETS ? bucket : SOAK_BUCKETS - 1]++;
+    if (latency > soak.latency[2]) soak.latency[2] = latency;
+}
+
+// one loop of the emulator, on the host the virtual clock advances by ms
+void Benchmark::soakLoop(uint32_t ms) {
+    network.loop();
+#ifdef NATIVE
+    broker.sync();      // the broker answers before the virtual clock moves on
+#endif
+    emulator.loop();
+    soakSample();
+#ifdef NATIVE
+    NativeClock::advance(ms);
+#endif
+}
+
+// time between the ticks, the panel serves the emulator's background status polls,
+// skipped on the device
+void Benchmark::soakIdle(uint32_t until, bool &armed) {
+#ifdef NATIVE
+    while ((int32_t)(millis() - until) < 0) {
+        soakLoop(SOAK_IDLE_STEP);
+        soakServeCommand(armed);
+    }
+#endif
+}
+
+void Benchmark::soakSample() {
+    Sim900 &sim = emulator.sim900;
+    soak.commandDepth = std::max(soak.commandDepth, (size_t)sim.commands.size());
+    soak.responseDepth = std::max(soak.responseDepth, (size_t)sim.response.size());
+    soak.messageDepth = std::max(soak.messageDepth, (size_t)std::max(sim.msgRxBuffer.size(), sim.msgTxBuffer.size()));
+    soak.arenaBlocks = std::max(soak.arenaBlocks, SmsArena::BLOCK_COUNT - sim.arena.getFreeBlocks());
+    soak.minFreeHeap = std::min(soak.minFreeHeap, (uint32_t)ESP.getMinFreeHeap());
+    soak.minFreeStack = std::min(soak.minFreeStack, (uint32_t)uxTaskGetStackHighWaterMark(nullptr));
+}
+
+// the panel reads an indicated SMS and confirms the command
+void Benchmark::soakServeCommand(bool &armed) {
+    Sim900 &sim = emulator.sim900;
+    if (!sim.smsTx.valid())
+        return;
+    SmsText text;
+    sim.arena.copy(sim.smsTx, text);
+    FixedString128 reply("Confirmed|PROG 1207 ");
+    const char* mode = strstr(text.c_str(), "MODE:");
+    if (mode != nullptr) {
+        armed = mode[5] != 'D';
+        reply.append(mode);
+    } else {
+        reply.append(armed ? "MOD?:A" : "MOD?:D");
+    }
+    soakExchange("AT+CMGR=1");
+    soakExchange("AT+CMGS=\"+4915773807779\"");
+    soakExchange(reply.c_str(), true);
+}
+
+uint32_t Benchmark::soakPercentile(uint32_t percent) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < SOAK_BUCKETS; ++i) total += soakHistogram[i];
+    uint32_t rank = (total * percent + 99) / 100;
+    uint32_t count = 0;
+    for (size_t i = 0; i < SOAK_BUCKETS; ++i) {
+        count += soakHistogram[i];
+        if (count >= rank && count > 0)
+            return (i + 1) * SOAK_BUCKET;  // upper bound of the bucket
+    }
+    return 0;
+}
+
+bool Benchmark::soakCheck(const char* name, uint32_t value, uint32_t limit, bool lowerLimit) {
+    bool ok = lowerLimit ? value >= limit : value <= limit;
+    if (!ok)
+        Serial << beginl << red << "Soak regression: " << name << " " << value << (lowerLimit ? " < " : " > ") << limit << DI::endl;
+    return ok;
+}
+
+#if defined(NATIVE) && !defined(PIO_UNIT_TESTING)
+// env:native has no Arduino runtime, the benchmarks run once with the emulator connected
+// to the broker stand-in, the soak test result is the exit code; with the argument "serve"
+// the main loop runs until the process is stopped, e.g. to load the status endpoint
+void setup();
+
+int main(int argc, char* argv[]) {
+    if (!broker.begin()) {
+        Serial << beginl << red << "Broker stand-in can't listen on port " << LoopbackBroker::PORT << DI::endl;
+        return 1;
+    }
+    WiFi.setStatus(WL_CONNECTED);
+    setup();
+    uint32_t start = millis();
+    while (!network.isConnected() && millis() - start < 5000)
+        loop();
+    if (!network.isConnected()) {
+        Serial << beginl << red << "No connection to the broker stand-in" << DI::endl;
+        return 1;
+    }
+    loop();     // connect edge: discovery and status replay
+    if (argc > 1 && strcmp(argv[1], "serve") == 0) {
+        Serial << beginl << "Serving until stopped" << DI::endl;
+        for (;;)
+            loop();
+    }
+    Benchmark::runEventStorm();
+    return Benchmark::runSoak() ? 0 : 1;
+}
+#endif
+
+#endif
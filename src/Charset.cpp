@@ -0,0 +1,256 @@
+#include "Charset.h"
+
+namespace Charset {
+
+// GSM 03.38 default alphabet to Unicode
+static constexpr uint16_t gsmToUnicode[128] = {
+    0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,  // @ £ $ ¥ è é ù ì
+    0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,  // ò Ç LF Ø ø CR Å å
+    0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,  // Δ _ Φ Γ Λ Ω Π Ψ
+    0x03A3, 0x0398, 0x039E, 0x001B, 0x00C6, 0x00E6, 0x00DF, 0x00C9,  // Σ Θ Ξ ESC Æ æ ß É
+    0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,  //   ! " # ¤ % & '
+    0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,  // ( ) * + , - . /
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,  // 0 - 7
+    0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,  // 8 9 : ; < = > ?
+    0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,  // ¡ A - G
+    0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,  // H - O
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,  // P - W
+    0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,  // X Y Z Ä Ö Ñ Ü §
+    0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,  // ¿ a - g
+    0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,  // h - o
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,  // p - w
+    0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0   // x y z ä ö ñ ü à
+};
+
+static constexpr uint8_t GSM_ESCAPE = 0x1B;
+static constexpr uint8_t NONE = 0xFF;
+
+// GSM 03.38 extension table, characters preceded by the escape character
+struct Extension {
+    uint8_t gsm;
+    uint16_t unicode;
+};
+static constexpr Extension gsmExtension[] = {
+    {0x0A, 0x000C}, {0x14, 0x005E}, {0x28, 0x007B}, {0x29, 0x007D}, {0x2F, 0x005C},
+    {0x3C, 0x005B}, {0x3D, 0x007E}, {0x3E, 0x005D}, {0x40, 0x007C}, {0x65, 0x20AC}
+};
+
+// Latin-1 range of Unicode to GSM default alphabet, NONE: not in the default alphabet
+struct Latin1Table {
+    uint8_t gsm[256];
+};
+static constexpr Latin1Table makeLatin1Table() {
+    Latin1Table t{};
+    for (size_t i = 0; i < 256; ++i) t.gsm[i] = NONE;
+    for (size_t i = 0; i < 128; ++i) {
+        if (i != GSM_ESCAPE && gsmToUnicode[i] < 256) t.gsm[gsmToUnicode[i]] = (uint8_t)i;
+    }
+    return t;
+}
+static constexpr Latin1Table latin1ToGsm = makeLatin1Table();
+
+static constexpr char hexDigits[] = "0123456789ABCDEF";
+
+// the output is truncated at the first character which doesn't fit, returns false then
+static inline bool put(char c, char* out, size_t &len, size_t size) {
+    if (len >= size - 1) return false;
+    out[len++] = c;
+    return true;
+}
+
+static bool putUtf8(uint32_t cp, char* out, size_t &len, size_t size) {
+    // only write complete sequences
+    size_t n = cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+    if (len + n > size - 1) return false;
+    if (n == 1) {
+        out[len++] = (char)cp;
+    } else if (n == 2) {
+        out[len++] = (char)(0xC0 | (cp >> 6));
+        out[len++] = (char)(0x80 | (cp & 0x3F));
+    } else if (n == 3) {
+        out[len++] = (char)(0xE0 | (cp >> 12));
+        out[len++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[len++] = (char)(0x80 | (cp & 0x3F));
+    } else {
+        out[len++] = (char)(0xF0 | (cp >> 18));
+        out[len++] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        out[len++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[len++] = (char)(0x80 | (cp & 0x3F));
+    }
+    return true;
+}
+
+// decoded character to UTF-8, line breaks are replaced by the SMS part separator
+static inline bool putText(uint32_t cp, char* out, size_t &len, size_t size) {
+    if (cp == '\r') return true;
+    return putUtf8(cp == '\n' ? '|' : cp, out, len, size);
+}
+
+static inline bool putHex(uint16_t unit, char* out, size_t &len, size_t size) {
+    if (len + 4 > size - 1) return false;
+    out[len++] = hexDigits[(unit >> 12) & 0xF];
+    out[len++] = hexDigits[(unit >> 8) & 0xF];
+    out[len++] = hexDigits[(unit >> 4) & 0xF];
+    out[len++] = hexDigits[unit & 0xF];
+    return true;
+}
+
+static inline bool isHighSurrogate(uint32_t unit) { return unit >= 0xD800 && unit < 0xDC00; }
+static inline bool isLowSurrogate(uint32_t unit) { return unit >= 0xDC00 && unit < 0xE000; }
+
+// read next code point from UTF-8 string, invalid sequences result in '?'
+static uint32_t nextUtf8(const unsigned char* &s) {
+    uint32_t cp = *s++;
+    int follow = 0;
+    if (cp < 0x80) return cp;
+    else if ((cp & 0xE0) == 0xC0) { cp &= 0x1F; follow = 1; }
+    else if ((cp & 0xF0) == 0xE0) { cp &= 0x0F; follow = 2; }
+    else if ((cp & 0xF8) == 0xF0) { cp &= 0x07; follow = 3; }
+    else return '?';
+    while (follow-- > 0) {
+        if ((*s & 0xC0) != 0x80) return '?';
+        cp = (cp << 6) | (*s++ & 0x3F);
+    }
+    return cp;
+}
+
+static inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool parse(const char* name, Type &out) {
+    // skip optional quotes
+    if (*name == '"') ++name;
+    if (strncmp(name, "GSM", 3) == 0) { out = Type::GSM; return true; }
+    if (strncmp(name, "IRA", 3) == 0) { out = Type::IRA; return true; }
+    if (strncmp(name, "UCS2", 4) == 0) { out = Type::UCS2; return true; }
+    return false;
+}
+
+const char* name(Type type) {
+    switch (type) {
+        case Type::GSM:  return "GSM";
+        case Type::UCS2: return "UCS2";
+        default:         return "IRA";
+    }
+}
+
+void decode(Type type, const char* in, char* out, size_t &len, size_t size) {
+    const unsigned char* s = (const unsigned char*)in;
+    bool room = true;
+    switch (type) {
+        case Type::GSM:
+            for (; *s && room; ++s) {
+                uint8_t c = *s;
+                if (c == (uint8_t)GSM_AT_PLACEHOLDER) {
+                    room = put('@', out, len, size);
+                } else if (c == GSM_ESCAPE) {
+                    if (s[1] == '\0')
+                        break;  // incomplete escape sequence
+                    uint8_t ext = *++s;
+                    uint32_t cp = ' ';
+                    for (const auto &e : gsmExtension) {
+                        if (e.gsm == ext) { cp = e.unicode; break; }
+                    }
+                    room = putText(cp, out, len, size);
+                } else if (c < 128) {
+                    room = putText(gsmToUnicode[c], out, len, size);
+                } else {
+                    room = put('?', out, len, size);
+                }
+            }
+            break;
+        case Type::UCS2: {
+            // UTF-16 surrogate pairs are combined, unpaired surrogates result in '?',
+            // an incomplete code unit at the end is ignored
+            uint32_t high = 0;
+            while (room && s[0] && s[1] && s[2] && s[3]) {
+                int d0 = hexValue(s[0]), d1 = hexValue(s[1]), d2 = hexValue(s[2]), d3 = hexValue(s[3]);
+                if (d0 < 0 || d1 < 0 || d2 < 0 || d3 < 0) break;
+                uint32_t unit = (uint32_t)((d0 << 12) | (d1 << 8) | (d2 << 4) | d3);
+                s += 4;
+                if (high != 0 && isLowSurrogate(unit)) {
+                    room = putText(0x10000 + ((high - 0xD800) << 10) + (unit - 0xDC00), out, len, size);
+                    high = 0;
+                    continue;
+                }
+                if (high != 0) {
+                    room = put('?', out, len, size);
+                    high = 0;
+                }
+                if (isHighSurrogate(unit))
+                    high = unit;
+                else if (room)
+                    room = isLowSurrogate(unit) ? put('?', out, len, size) : putText(unit, out, len, size);
+            }
+            if (high != 0 && room)
+                put('?', out, len, size);
+            break;
+        }
+        default:
+            for (; *s && room; ++s) {
+                room = putText(*s < 0x80 ? *s : '?', out, len, size);
+            }
+            break;
+    }
+    out[len] = '\0';
+}
+
+void encode(Type type, const char* in, char* out, size_t &len, size_t size) {
+    const unsigned char* s = (const unsigned char*)in;
+    bool room = true;
+    while (*s && room) {
+        uint32_t cp = nextUtf8(s);
+        switch (type) {
+            case Type::GSM: {
+                uint8_t gsm = cp < 256 ? latin1ToGsm.gsm[cp] : NONE;
+                if (gsm == NONE) {
+                    // greek capitals of the default alphabet
+                    for (uint8_t i = 0x10; i < 0x20 && gsm == NONE; ++i) {
+                        if (gsmToUnicode[i] == cp && i != GSM_ESCAPE) gsm = i;
+                    }
+                }
+                if (gsm != NONE) {
+                    room = put(gsm == 0 ? GSM_AT_PLACEHOLDER : (char)gsm, out, len, size);
+                    break;
+                }
+                uint8_t ext = NONE;
+                for (const auto &e : gsmExtension) {
+                    if (e.unicode == cp) { ext = e.gsm; break; }
+                }
+                if (ext == NONE) {
+                    room = put('?', out, len, size);
+                } else if (len + 2 <= size - 1) {
+                    out[len++] = (char)GSM_ESCAPE;
+                    out[len++] = (char)ext;
+                } else {
+                    room = false;
+                }
+                break;
+            }
+            case Type::UCS2:
+                if (isHighSurrogate(cp) || isLowSurrogate(cp) || cp > 0x10FFFF) {
+                    room = putHex('?', out, len, size);
+                } else if (cp > 0xFFFF) {
+                    // beyond the BMP as UTF-16 surrogate pair, both units or none
+                    room = len + 8 <= size - 1;
+                    if (room) {
+                        putHex(0xD800 + ((cp - 0x10000) >> 10), out, len, size);
+                        putHex(0xDC00 + ((cp - 0x10000) & 0x3FF), out, len, size);
+                    }
+                } else {
+                    room = putHex(cp, out, len, size);
+                }
+                break;
+            default:
+                room = put(cp < 0x80 ? (char)cp : '?', out, len, size);
+                break;
+        }
+    }
+    out[len] = '\0';
+}
+
+} // namespace Charset
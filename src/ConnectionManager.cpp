@@ -0,0 +1,254 @@
+#include "ConnectionManager.h"
+#include "DebugInterface.h"
+#include <lwip/sockets.h>
+
+// debug output module identifier
+static inline Print& beginl(Print &stream) {
+    static constexpr const char name[] = "NET";
+    return beginl<name>(stream);
+}
+
+void ManagedClient::attach(int fd) {
+    drop(nullptr);
+    this->fd = fd;
+    error = nullptr;
+    expired = false;
+}
+
+size_t ManagedClient::write(const uint8_t* buffer, size_t size) {
+    if (fd < 0)
+        return 0;
+    int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+    ssize_t n = send(fd, buffer, size, flags);
+    if (n != (ssize_t)size) {
+        drop(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK ? "MQTT send failed" : "MQTT send buffer full");
+        return 0;
+    }
+    return size;
+}
+
+int ManagedClient::available() {
+    size_t n = receive();
+    if (n > 0) {
+        polling = false;
+        return n;
+    }
+    if (fd >= 0 && armed && (int32_t)(micros() - deadline) >= 0) {
+        // a single check for data isn't a wait, the busy loop of the MQTT library asks again
+        if (polling) {
+            expired = true;
+            drop("MQTT read timeout");
+        }
+        polling = true;
+    }
+    return fd < 0 ? 1 : 0;  // closed: the waiting read fails at once
+}
+
+int ManagedClient::read() {
+    return receive() > 0 ? rx[rxStart++] : -1;
+}
+
+int ManagedClient::read(uint8_t* buffer, size_t size) {
+    size_t n = receive();
+    if (n == 0)
+        return -1;
+    if (n > size)
+        n = size;
+    memcpy(buffer, rx + rxStart, n);
+    rxStart += n;
+    return n;
+}
+
+int ManagedClient::peek() {
+    return receive() > 0 ? rx[rxStart] : -1;
+}
+
+// bytes buffered, receives without blocking if the buffer is empty
+size_t ManagedClient::receive() {
+    if (rxStart < rxEnd)
+        return rxEnd - rxStart;
+    rxStart = rxEnd = 0;
+    if (fd < 0)
+        return 0;
+    ssize_t n = recv(fd, rx, sizeof(rx), MSG_DONTWAIT);
+    if (n > 0)
+        rxEnd = n;
+    else if (n == 0)
+        drop("MQTT connection closed by broker");
+    else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        drop("MQTT receive failed");
+    return rxEnd;
+}
+
+void ManagedClient::drop(const char* reason) {
+    // the MQTT library stops a closed client again, the first reason is kept
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+        error = reason;
+    }
+    rxStart = rxEnd = 0;
+}
+
+bool ConnectionManager::begin(const char* username, const char* password) {
+    this->username = username;
+    this->password = password;
+    stateTime = millis();
+    // only configures the client, the connection is opened by loop()
+    return mqtt.begin(broker, port, username, password);
+}
+
+void ConnectionManager::loop() {
+    if (millis() - deferStart < deferTime)
+        return;
+    uint32_t start = micros();
+    step(millis());
+    uint32_t elapsed = micros() - start;
+    if (elapsed > stats.maxStep) stats.maxStep = elapsed;
+    deferTime = 0;
+    if (elapsed > NETWORK_BUDGET) {
+        stats.overruns++;
+        deferStart = millis();
+        deferTime = (elapsed - NETWORK_BUDGET) / 1000;
+    }
+}
+
+void ConnectionManager::setState(State newState) {
+    state = newState;
+    stateTime = millis();
+}
+
+void ConnectionManager::step(uint32_t now) {
+    if (WiFi.status() != WL_CONNECTED && state != State::WifiConnecting) {
+        Serial << beginl << red << "WiFi lost" << DI::endl;
+        dropSession();
+        backoff = RECONNECT_MIN;
+        retryDelay = RECONNECT_MIN;
+        setState(State::WifiConnecting);
+        return;
+    }
+    switch (state) {
+        case State::WifiConnecting:
+            if (WiFi.status() == WL_CONNECTED) {
+                startConnect();
+            } else if (now - stateTime >= retryDelay) {
+                // the WiFi driver reconnects by itself, retry in case it gave up
+                Serial << beginl << "WiFi reconnect" << DI::endl;
+                WiFi.reconnect();
+                stateTime = now;
+            }
+            break;
+        case State::Backoff:
+            if (now - stateTime >= retryDelay)
+                startConnect();
+            break;
+        case State::TcpConnecting:
+            pollConnect(now);
+            break;
+        case State::MqttConnecting:
+            // socket is connected, the MQTT client only sends CONNECT and waits for CONNACK
+            mqttLoop(CONNACK_TIMEOUT);
+            if (mqtt.isConnected()) {
+                Serial << beginl << green << "MQTT session established after " << now - stateTime << " ms" << DI::endl;
+                backoff = RECONNECT_MIN;
+                setState(State::Connected);
+            } else {
+                fail(client.deadlineExpired() ? "MQTT CONNACK timeout" :
+                     client.getError() ? client.getError() : "MQTT session rejected");
+            }
+            break;
+        case State::Connected:
+            if (client.connected() && mqtt.isConnected())
+                mqttLoop(NETWORK_BUDGET);
+            if (!client.connected() || !mqtt.isConnected()) {
+                // also a publish from the main loop which didn't fit into the send buffer
+                backoff = RECONNECT_MIN;
+                fail(client.getError() ? client.getError() : "MQTT connection lost");
+            }
+            break;
+    }
+}
+
+// reads of the MQTT client are bounded by the deadline, microseconds from now
+void ConnectionManager::mqttLoop(uint32_t timeout) {
+    client.startDeadline(timeout);
+    mqtt.loop();
+    client.stopDeadline();
+}
+
+void ConnectionManager::startConnect() {
+    stats.attempts++;
+    client.stop();
+    fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        fail("no socket");
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = (uint32_t)broker;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        fail("connect failed");
+        return;
+    }
+    Serial << beginl << "Connecting to broker " << broker << ":" << port << ", attempt " << stats.attempts << DI::endl;
+    setState(State::TcpConnecting);
+}
+
+void ConnectionManager::pollConnect(uint32_t now) {
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval tv = {0, 0};
+    int ready = select(fd + 1, nullptr, &writeSet, nullptr, &tv);
+    if (ready == 0) {
+        if (now - stateTime >= TCP_CONNECT_TIMEOUT)
+            fail("TCP connect timeout");
+        return;
+    }
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (ready < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+        fail("TCP connect refused");
+        return;
+    }
+    // the socket stays non-blocking, hand it over to the MQTT client
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    client.attach(fd);
+    fd = -1;
+    // the MQTT client was reset by dropSession(), it sends CONNECT on the new socket
+    mqtt.begin(broker, port, username, password);
+    setState(State::MqttConnecting);
+}
+
+void ConnectionManager::closeSocket() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// close the connection and reset the MQTT client, a still set connected state would
+// take the next socket for the old session without sending CONNECT
+void ConnectionManager::dropSession() {
+    closeSocket();
+    mqtt.disconnect();
+    client.stop();
+}
+
+void ConnectionManager::fail(const char* reason) {
+    dropSession();
+    stats.failures++;
+    // exponential backoff, jitter of up to 25 % spreads retries of several devices
+    retryDelay = backoff + random(backoff / 4 + 1);
+    backoff = backoff * 2 > RECONNECT_MAX ? RECONNECT_MAX : backoff * 2;
+    Serial << beginl << red << reason << ", retry in " << retryDelay / 1000 << " s" << DI::endl;
+    setState(State::Backoff);
+}
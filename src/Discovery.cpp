@@ -0,0 +1,41 @@
+#include "Discovery.h"
+#include "FixedString.h"
+
+namespace Discovery {
+
+static bool published = false;
+static bool requested = false;
+static FixedString128 birthTopic;
+
+static void onMessage(const char* topic, const uint8_t* payload, uint16_t length) {
+    if (strcmp(topic, birthTopic.c_str()) == 0 && length == 6 && memcmp(payload, "online", 6) == 0)
+        requested = true;   // handled in the main loop, not from within the MQTT client
+}
+
+void begin(HAMqtt &mqtt) {
+    birthTopic.set(mqtt.getDiscoveryPrefix());
+    birthTopic.append("/status");
+    mqtt.onMessage(onMessage);
+}
+
+void connected(HAMqtt &mqtt) {
+    // subscriptions don't survive a reconnect
+    mqtt.subscribe(birthTopic.c_str());
+    published = true;
+}
+
+bool isPublished() {
+    return published;
+}
+
+void setPublished(bool value) {
+    published = value;
+}
+
+bool takeRequest() {
+    bool r = requested;
+    requested = false;
+    return r;
+}
+
+} // namespace Discovery
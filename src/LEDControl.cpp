@@ -5,63 +5,67 @@ LEDControl::LEDControl(uint8_t pin, bool inverted) : pin(pin), inverted(inverted
     set(false);
 }
 
-void LEDControl::setState(LedState newState) {
-    // if flashes are running, just remember new state for later
-    if (flashActive) {
-        savedState = newState;
+void LEDControl::begin() {
+    if (timer != nullptr)
         return;
-    }
-    currentState = newState;
-    lastToggle = millis();
-    if (newState == LED_ON) {
-        set(true);
-    } else if (newState == LED_OFF) {
-        set(false);
-    }
+    esp_timer_create_args_t args = {};
+    args.callback = &LEDControl::onTick;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "led";
+    if (esp_timer_create(&args, &timer) == ESP_OK)
+        esp_timer_start_periodic(timer, TICK * 1000);
+}
+
+// restart layer with the first step of the pattern, returns its LED state
+bool LEDControl::start(Layer &layer, const Pattern &pattern, uint16_t steps) {
+    layer.pattern = &pattern;
+    layer.step = 0;
+    layer.ticksLeft = pattern.steps[0].ticks;
+    layer.stepsLeft = steps;
+    return pattern.steps[0].on;
+}
+
+void LEDControl::setState(LedState newState) {
+    portENTER_CRITICAL(&mux);
+    bool on = start(base, patterns[newState], 0);
+    // while flashes are running, the new state starts afterwards
+    if (!overlayActive)
+        set(on);
+    portEXIT_CRITICAL(&mux);
 }
 
 void LEDControl::indicate(uint8_t flashNum) {
-    flashActive = true;
-    flashCount = flashNum;
-    flashesDone = 0;
-    flashTimer = millis();
-    set(false);
-    // save current mode so we can restore it afterwards
-    savedState = currentState;
+    if (flashNum == 0)
+        return;
+    portENTER_CRITICAL(&mux);
+    // off/on per flash, plus a final off step to separate the last flash from the regular state
+    bool on = start(overlay, flashPattern, flashNum * flashPattern.count + 1);
+    overlayActive = true;
+    set(on);
+    portEXIT_CRITICAL(&mux);
 }
 
-void LEDControl::loop() {
-    uint32_t now = millis();
+void LEDControl::onTick(void* arg) {
+    static_cast<LEDControl*>(arg)->tick();
+}
 
-    if (flashActive) {
-        // handle one-shot flash pattern
-        if (now - flashTimer >= FLASH_INTERVAL) {
-            flashTimer = now;
-            toggle();
-            if (!ledState) { // only count when OFF cycle ends
-                flashesDone++;
-                if (flashesDone >= flashCount) {
-                    flashActive = false;
-                    setState(savedState); // restore regular state
-                }
-            }
-        }
-    } else {
-        // handle regular LED states
-        auto blinkInterval = BLINK_FAST;
-        switch (currentState) {
-            case LED_OFF:
-            case LED_ON:
-                break;
-            case LED_FLASH_SLOW:
-                blinkInterval = BLINK_SLOW;
-                // fall through
-            case LED_FLASH_FAST:
-                if (now - lastToggle >= blinkInterval) {
-                    lastToggle = now;
-                    toggle();
-                }
-                break;
+void LEDControl::tick() {
+    portENTER_CRITICAL(&mux);
+    Layer &layer = overlayActive ? overlay : base;
+    // steps with 0 ticks are held until the pattern is replaced
+    bool changed = layer.ticksLeft > 0 && --layer.ticksLeft == 0;
+    if (changed) {
+        if (++layer.step >= layer.pattern->count)
+            layer.step = 0;
+        layer.ticksLeft = layer.pattern->steps[layer.step].ticks;
+        if (layer.stepsLeft > 0 && --layer.stepsLeft == 0) {
+            // flashes done, restore the regular state
+            overlayActive = false;
+            start(base, *base.pattern, 0);
         }
+        const Layer &current = overlayActive ? overlay : base;
+        set(current.pattern->steps[current.step].on);
     }
+    portEXIT_CRITICAL(&mux);
 }
@@ -10,9 +10,168 @@ static inline Print& beginl(Print &stream) {
 void Sim900::init() {
     ModemSerial.begin(MODEM_BAUD, SERIAL_8N1, MODEM_RX, MODEM_TX); // ESP32 <-> SA2700
     Serial << beginl << "Modem serial started at " << MODEM_BAUD << " baud, rx pin: " << MODEM_RX << ", tx pin: " << MODEM_TX << DI::endl;
+    Serial << beginl << "Panel profile: " << Panel::name << DI::endl;
     commands.push(FixedString128("ATZ")); // force sending startup messages
 }
 
+void Sim900::queueScript(const Script &script) {
+    for (const Script* sc = &script; sc != nullptr; sc = sc->next) {
+        for (uint8_t i = 0; i < sc->count; ++i) {
+            if (!response.push(&sc->lines[i])) {
+                Serial << beginl << red << "Response buffer full, dropping: " << sc->lines[i].text << DI::endl;
+            }
+        }
+    }
+}
+
+void Sim900::queueLine(const FixedString128 &line) {
+    // both queues are checked first, a text without its line would be sent with the next dynamic line
+    if (responseText.size() >= RESPONSE_TEXTS || response.size() >= RESPONSE_LINES) {
+        Serial << beginl << red << "Response buffer full, dropping: " << line << DI::endl;
+        return;
+    }
+    responseText.push(line);
+    response.push(&Scripts::dynamicLine);
+}
+
+bool Sim900::pushMessage(FIFObuf<SmsMessage> &buf, const char* text, uint16_t traceId) {
+    SmsMessage msg{SmsHandle(), traceId};
+    arena.append(msg.body, text);
+    if (!buf.push(msg)) {
+        arena.release(msg.body);
+        return false;
+    }
+    return true;
+}
+
+void Sim900::clearMessages(FIFObuf<SmsMessage> &buf) {
+    while (buf.size() > 0) {
+        SmsMessage msg = buf.pop();
+        arena.release(msg.body);
+    }
+}
+
+void Sim900::startResponse() {
+    // take next response line, it is sent after its delay expired
+    if (response.size() == 0) {
+        state = ModemState::Idle;
+        return;
+    }
+    nextResponse = response.pop();
+    delayCount = millis() + nextResponse->delay;
+    state = ModemState::WaitToSend;
+}
+
+void Sim900::receiveSmsChar(char c) {
+    if (c == 26) {
+        receiveSmsLine(true);  // Ctrl+Z, used to end SMS body
+    } else if (c == '\n') {
+        receiveSmsLine(false);
+    } else if (c == '\r') {
+        // ignore carriage return
+    } else if (c >= 0 && c < 32 && charset != Charset::Type::GSM) {
+        Serial << beginl << red << "Received control character: " << (int)c << ", ignore" << DI::endl;
+    } else {
+        // GSM 7-bit alphabet uses control characters for printable characters
+        rxBuffer += (c == 0 ? Charset::GSM_AT_PLACEHOLDER : c);
+        if (rxBuffer.length() == rxBuffer.capacity())
+            decodeSmsLine(false);  // long line, decode what arrived so far
+    }
+}
+
+// SMS body lines bypass the command buffer, they are decoded and appended to the SMS in the arena
+void Sim900::receiveSmsLine(bool end) {
+    if (rxBuffer.length() > 0 || smsLineOpen)
+        decodeSmsLine(true);
+    if (end) {
+        arena.copy(smsRx, smsText);
+        Serial << beginl << "Received SMS from host: " << smsText << DI::endl;
+        if (smsRx.truncated) {
+            Serial << beginl << red << "SMS truncated to " << smsRx.length << " bytes, overflows: " << arena.getOverflows() << DI::endl;
+        }
+        Trace::hop(replyTrace, Trace::Hop::Received);
+        if (!msgRxBuffer.push(SmsMessage{smsRx, replyTrace})) { // store the received SMS
+            droppedMessages++;
+            Serial << beginl << red << "Message buffer full, dropping: " << smsText << DI::endl;
+            arena.release(smsRx);
+        }
+        smsRx = SmsHandle();
+        replyTrace = 0;
+        replyPending = false;
+        queueScript(Scripts::smsSent);
+        receiveSMS = false; // done
+    } else {
+        queueScript(Scripts::prompt); // prompt for more SMS content
+    }
+    if (state == ModemState::Idle)
+        startResponse();
+}
+
+// decodes the received part of an SMS body line in pieces and appends it to the SMS in the arena,
+// don't split GSM escape sequences, UCS2 characters and surrogate pairs, complete: end of the line,
+// otherwise the rest that doesn't fill a piece stays in rxBuffer for the next part
+void Sim900::decodeSmsLine(bool complete) {
+    static constexpr size_t PIECE = 64;
+    Serial << beginl << blue << "RX: " << rxBuffer << DI::endl;
+    if (!smsLineOpen && smsRx.length != 0)
+        arena.append(smsRx, "|");  // separate SMS body parts
+    smsLineOpen = !complete;
+    const char* s = rxBuffer.c_str();
+    size_t remaining = rxBuffer.length();
+    while (remaining >= (complete ? 1 : PIECE)) {
+        FixedString<PIECE + 1> raw;
+        FixedString<3 * PIECE + 1> text;
+        size_t n = remaining < PIECE ? remaining : PIECE;
+        bool more = n < remaining || !complete;     // the line continues after this piece
+        if (more && charset == Charset::Type::GSM && s[n - 1] == 0x1B) --n;
+        if (more && charset == Charset::Type::UCS2 && (s[n - 4] == 'D' || s[n - 4] == 'd') &&
+            strchr("89ABab", s[n - 3]) != nullptr) n -= 4;
+        memcpy(raw.buf, s, n);
+        raw.buf[n] = '\0';
+        raw.len = n;
+        Charset::decode(charset, raw, text);
+        arena.append(smsRx, text.c_str(), text.length());
+        s += n;
+        remaining -= n;
+    }
+    rxBuffer.remove(0, rxBuffer.length() - remaining);
+}
+
+// send the SMS body read by the host in the host's character set
+void Sim900::sendSmsBody() {
+    arena.copy(smsTxSending, smsText);
+    arena.release(smsTxSending);
+    // encode in pieces, split at UTF-8 character boundaries
+    static constexpr size_t PIECE = 32;
+    const char* s = smsText.c_str();
+    size_t remaining = smsText.length();
+    while (remaining > 0) {
+        FixedString<PIECE + 1> text;
+        FixedString<4 * PIECE + 1> encoded;
+        size_t n = remaining < PIECE ? remaining : PIECE;
+        while (n < remaining && n > 0 && ((unsigned char)s[n] & 0xC0) == 0x80) --n;
+        memcpy(text.buf, s, n);
+        text.buf[n] = '\0';
+        text.len = n;
+        Charset::encode(charset, text, encoded);
+        for (const char* c = encoded.c_str(); *c; ++c) {
+            ModemSerial.write(*c == Charset::GSM_AT_PLACEHOLDER ? (uint8_t)0 : (uint8_t)*c);
+        }
+        s += n;
+        remaining -= n;
+    }
+    ModemSerial.print("\r\n");
+    Serial << beginl << cyan << "TX: " << smsText << DI::endl;
+}
+
+const Script* Sim900::findScript(const char* cmd) const {
+    for (const auto &entry : Panel::commands) {
+        if (entry.matches(cmd))
+            return entry.script;
+    }
+    return nullptr;
+}
+
 void Sim900::splitCommands() {
     int start = 0;
     rxBuffer.trim();
@@ -29,8 +188,6 @@ void Sim900::splitCommands() {
     while (start < len) {
         int end = start;
         while (end < len && s[end] != ';') ++end;
-        // copy from start..end-1 into fixed buffer
-        int seglen = end - start;
         // trim whitespace from both ends
         int segStart = start;
         int segEnd = end - 1;
@@ -52,30 +209,35 @@ void Sim900::splitCommands() {
     rxBuffer.clear();
 }
 
-void Sim900::sendToHost(const FixedString128 &msg) {
-    ModemSerial.print(msg.c_str());
+void Sim900::sendToHost(const char* msg) {
+    for (const char* c = msg; *c; ++c) {
+        // GSM '@' is stored as placeholder in C strings
+        ModemSerial.write(*c == Charset::GSM_AT_PLACEHOLDER ? (uint8_t)0 : (uint8_t)*c);
+    }
     ModemSerial.print("\r\n");
-    Serial << beginl << cyan << "TX: " << msg.c_str() << DI::endl;
+    Serial << beginl << cyan << "TX: " << msg << DI::endl;
 }
 
 void Sim900::loop() {
 
-    auto startDelay = [this](unsigned long duration=responseDelay) {
-        delayCount = millis() + duration;
-        state = ModemState::WaitToSend;
-    };
+    uint32_t now = micros();
+    if (lastLoop != 0 && now - lastLoop > maxLoopGap)
+        maxLoopGap = now - lastLoop;
+    lastLoop = now;
 
     while (ModemSerial.available()) {
         char c = ModemSerial.read();
-        if (c < 32 && c != '\r' && c != '\n' && c != 26) {
+        if (receiveSMS) {
+            receiveSmsChar(c);
+            continue;
+        }
+        if (c < 32 && c != '\r' && c != '\n') {
             Serial << beginl << red << "Received control character: " << (int)c << ", ignore" << DI::endl;
             continue;
         }
         if (c == '\r')
             continue; // ignore carriage return
-        if (receiveSMS && c == 26)
-            textEnd = true;  // Ctrl+Z, used to end SMS body
-        if (c == '\n' || textEnd) {
+        if (c == '\n') {
             if (rxBuffer.length() > 0)
                 splitCommands();
         } else {
@@ -90,15 +252,16 @@ void Sim900::loop() {
                 state = ModemState::ProcessCommand;
             } else if (msgTxBuffer.size() > 0) {
                 // check if there are SMS messages to be sent to the host
-                FixedString128 fs;
-                fs = msgTxBuffer.pop();
-                smsTxBuffer = fs;  // set SMS body to be sent
+                SmsMessage msg = msgTxBuffer.pop();
+                arena.release(smsTx);  // previous SMS not read by the host
+                smsTx = msg.body;      // set SMS body to be sent
+                smsTxTrace = msg.traceId;
+                smsTxTime = millis();
+                Trace::hop(smsTxTrace, Trace::Hop::Indicated);
                 // send unsolicited SMS indication to the host
-                snprintf(fs.buf, sizeof(fs.buf), "+CMTI: \"SM\",%s", smsId);
-                fs.len = strnlen(fs.buf, sizeof(fs.buf)-1);
-                response.push(fs);
-                Serial << beginl << green << "Indicate SMS to host, id: " << smsId << DI::endl;
-                startDelay();   
+                queueScript(Scripts::cmti);
+                Serial << beginl << green << "Indicate SMS to host, id: " << Scripts::smsId << DI::endl;
+                startResponse();
             }
             break;
         case ModemState::ProcessCommand: {
@@ -107,93 +270,49 @@ void Sim900::loop() {
             cmdFs = commands.pop();
             ccmd = cmdFs.c_str();
 
-            if (receiveSMS) {
-                if (smsRxBuffer.length() != 0)
-                    smsRxBuffer += "|";  // separate SMS body parts
-                smsRxBuffer += ccmd;
-                if (textEnd) {
-                    textEnd = false;
-                    Serial << beginl << "Received SMS from host: " << smsRxBuffer << DI::endl;
-                    FixedString128 fs(smsRxBuffer);
-                    if (!msgRxBuffer.push(fs)) { // store the received SMS
-                        Serial << beginl << red << "Message buffer full, dropping: " << smsRxBuffer << DI::endl;
-                    }      
-                    smsRxBuffer.clear();
-                    response.push(FixedString128("+CMGS: 123")); // simulate SMS sent response
-                    response.push(FixedString128("OK"));
-                    receiveSMS = false; // done
-                } else {
-                    response.push(FixedString128(">")); // prompt for more SMS content
-                }
-                startDelay();
-                return;
-            }
             // process AT commands using C strings to avoid String allocations
             Serial << beginl << yellow << "Processing command: " << ccmd << DI::endl;
-            if (strcmp(ccmd, "AT") == 0 ||           // basic attention command
-                strcmp(ccmd, "ATH") == 0 ||          // hang up
-                strcmp(ccmd, "+CMGF=1") == 0 ||      // set SMS text mode
-                strcmp(ccmd, "+CNMI=3,1") == 0 ||    // new SMS message indications
-                strcmp(ccmd, "+CMGDA=\"DEL ALL\"") == 0 ||  // delete all SMS messages
-                strncmp(ccmd, "+IPR=", 5) == 0 ||    // set fixed baud rate
-                strncmp(ccmd, "+CSCS=", 6) == 0 ||   // set character set
-                strncmp(ccmd, "+CMGD=", 6) == 0 ||   // delete SMS message by index
-                strncmp(ccmd, "+CLTS=", 6) == 0 ||   // set local time stamp
-                strncmp(ccmd, "+CSCLK=", 7) == 0 ||  // set slow clock mode
-                strncmp(ccmd, "+CMEE=", 6) == 0 ||   // set extended error reporting
-                strncmp(ccmd, "+CSDT=", 6) == 0 ||   // set data type
-                strncmp(ccmd, "+MORING=", 8) == 0 || // set MO ring
-                strncmp(ccmd, "+CSMINS=", 8) == 0 || // SIM card status
-                strncmp(ccmd, "+CSMP=", 6) == 0) {   // set SMS parameters
-                response.push(FixedString128("OK"));
-            } else if (strcmp(ccmd, "ATZ") == 0) {
-                // reset the modem
-                response.push(FixedString128("OK"));
-                response.push(FixedString128("RDY"));
-                response.push(FixedString128("+CSMINS: 1,1"));
-                response.push(FixedString128("+CFUN: 1"));
-                response.push(FixedString128("+CPIN: READY"));
-                response.push(FixedString128("Call Ready"));
-            } else if (strcmp(ccmd, "+CPOWD=1") == 0) {
-                // power down the modem
-                response.push(FixedString128("NORMAL POWER DOWN"));
-                response.push(FixedString128("OK"));
-                response.push(FixedString128("RDY"));
-                response.push(FixedString128("+CSMINS: 1,1"));
-                response.push(FixedString128("+CFUN: 1"));
-                response.push(FixedString128("+CPIN: READY"));
-                response.push(FixedString128("Call Ready"));
-            } else if (strncmp(ccmd, "+CPIN?", 6) == 0) {
-                // simulate SIM card ready status
-                response.push(FixedString128("+CPIN: READY"));
-                response.push(FixedString128("OK"));
-            } else if (strcmp(ccmd, "+CCLK?") == 0) {
-                // current clock request
-                response.push(FixedString128("+CCLK: \"25/01/01,12:00:00+08\""));
-                response.push(FixedString128("OK"));
-            } else if (strcmp(ccmd, "+CSQ") == 0) {
-                // signal quality request
-                response.push(FixedString128("+CSQ: 23,0"));
-                response.push(FixedString128("OK"));
-            } else if (strcmp(ccmd, "+CREG?") == 0) {
-                // network registration status request
-                response.push(FixedString128("+CREG: 0,1"));
-                response.push(FixedString128("OK"));
-            } else if (strncmp(ccmd, "+CMGR=", 6) == 0 && strcmp(ccmd + 6, smsId) == 0) {
+            if (const Script* script = findScript(ccmd)) {
+                queueScript(*script);
+            } else if (strncmp(ccmd, "+CMGR=", 6) == 0 && strcmp(ccmd + 6, Scripts::smsId) == 0) {
                 // read SMS message by index
-                if (smsTxBuffer.length() > 0) {
+                if (smsTx.valid() && (response.size() + READ_LINES > RESPONSE_LINES || responseText.size() >= RESPONSE_TEXTS)) {
+                    // the SMS stays indicated, the host can read it again
+                    Serial << beginl << red << "Response buffer full, SMS not read" << DI::endl;
+                    queueScript(Scripts::error);
+                } else if (smsTx.valid()) {
                     FixedString160 tmp;
-                    snprintf(tmp.buf, sizeof(tmp.buf), "+CMGR: \"REC UNREAD\",\"%s\",,\"25/01/01,12:00:00+08\"", phoneNumber);
+                    FixedString128 text;
+                    Charset::encode(charset, phoneNumber, text);
+                    snprintf(tmp.buf, sizeof(tmp.buf), "+CMGR: \"REC UNREAD\",\"%s\",,\"25/01/01,12:00:00+08\"", text.c_str());
                     tmp.len = strnlen(tmp.buf, sizeof(tmp.buf)-1);
-                    response.push(FixedString128(tmp.c_str()));
+                    queueLine(FixedString128(tmp.c_str()));
                     // send the SMS content
-                    FixedString128 fs(smsTxBuffer);
-                    response.push(FixedString128(smsTxBuffer));
-                    response.push(FixedString128("OK"));
-                    smsTxBuffer.clear(); // clear the SMS content after sending
+                    arena.release(smsTxSending);
+                    smsTxSending = smsTx;
+                    smsTx = SmsHandle();
+                    response.push(&Scripts::smsBodyLine);  // room checked above
+                    queueScript(Scripts::ok);
+                    // the panel's next SMS is expected to be the reply to this one
+                    Trace::hop(smsTxTrace, Trace::Hop::Read);
+                    replyTrace = smsTxTrace;
+                    smsTxTrace = 0;
+                    replyPending = true;
+                    smsTxTime = millis();
+                } else {
+                    queueScript(Scripts::error); // no SMS at this index, strange ...
+                }
+            } else if (strncmp(ccmd, "+CSCS=", 6) == 0) {
+                // set character set
+                Charset::Type cs;
+                if (Charset::parse(ccmd + 6, cs)) {
+                    charset = cs;
+                    Serial << beginl << "Character set: " << Charset::name(charset) << DI::endl;
                 } else {
-                    response.push(FixedString128("ERROR")); // no SMS at this index, strange ...
+                    // keep the current character set
+                    Serial << beginl << red << "Unsupported character set: " << ccmd + 6 << DI::endl;
                 }
+                queueScript(Scripts::ok);
             } else if (strncmp(ccmd, "+CMGS=", 6) == 0) {
                 // receive SMS from host
                 // find first and last quote
@@ -215,13 +334,14 @@ void Sim900::loop() {
                 smsNumber.buf[copyLen] = '\0';
                 smsNumber.len = copyLen;
                 receiveSMS = true;
-                smsRxBuffer.clear(); // clear the buffer for new SMS content
-                response.push(FixedString128(">"));  // prompt for SMS body
+                Trace::hop(replyTrace, Trace::Hop::Reply);
+                arena.release(smsRx); // clear the buffer for new SMS content
+                queueScript(Scripts::prompt);  // prompt for SMS body
             } else {
                 Serial << beginl << red << "Unknown command: " << ccmd << DI::endl;
-                response.push(FixedString128("ERROR"));
+                queueScript(Scripts::error);
             }
-            startDelay();
+            startResponse();
             break;
         }
         case ModemState::WaitToSend:
@@ -232,11 +352,15 @@ void Sim900::loop() {
             break;
         case ModemState::SendResponse: {
             // send cummulated responses with a delay in between
-            FixedString128 respFs;
-            respFs = response.pop();
-            sendToHost(respFs);
+            if (nextResponse == &Scripts::smsBodyLine) {
+                sendSmsBody();
+            } else if (nextResponse->text != nullptr) {
+                sendToHost(nextResponse->text);
+            } else {
+                sendToHost(responseText.pop());
+            }
             if (response.size() > 0) {
-                startDelay();
+                startResponse();
             } else {
                 state = ModemState::Idle;
             }
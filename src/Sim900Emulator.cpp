@@ -1,7 +1,15 @@
 #include "Sim900Emulator.h"
 #include "credentials.h"
 #include "DebugInterface.h"
+#include "Benchmark.h"
+#include "ConnectionManager.h"
+#include "Discovery.h"
+#include "StatusServer.h"
 #include <WiFi.h>
+#include <vector>
+#ifdef NATIVE
+#include <LoopbackBroker.h>
+#endif
 
 // debug output module identifier
 static inline Print& beginl(Print &stream) {
@@ -10,18 +18,25 @@ static inline Print& beginl(Print &stream) {
 }
 
 Emulator emulator;
-WiFiClient client;
+ManagedClient client;
 HADevice device;
 HAMqtt mqtt(client, device);
+#ifdef NATIVE
+// env:native connects to the broker stand-in of lib/NativeShim
+ConnectionManager network(mqtt, client, IPAddress(127, 0, 0, 1), LoopbackBroker::PORT);
+#else
+ConnectionManager network(mqtt, client, BROKER_ADDR);
+#endif
+StatusServer httpServer(emulator);
 
 // note: HAMqtt must be initialized before any sensors
-HASensor status("alarmcontrol_status");
-HASensor source("alarmcontrol_source");
-HASensor message("alarmcontrol_message");
+// sources, message and time of the last panel message are published as JSON attributes of the status
+// discovery configs are only published on the first connection and after Home Assistant restarted
+Discovery::Cached<HASensor> status("alarmcontrol_status", HASensor::JsonAttributesFeature);
 
-HAButton updateCmd("alarmcontrol_update");
-HAButton armCmd("alarmcontrol_arm");
-HAButton disarmCmd("alarmcontrol_disarm");
+Discovery::Cached<HAButton> updateCmd("alarmcontrol_update");
+Discovery::Cached<HAButton> armCmd("alarmcontrol_arm");
+Discovery::Cached<HAButton> disarmCmd("alarmcontrol_disarm");
 
 // button command callback
 static void onButtonCommand(HAButton* sender) {
@@ -38,6 +53,9 @@ void setup() {
     Serial.begin(MONITOR_BAUD);
     Serial << beginl << "Emulator v" << VERSION << " started" << DI::endl;
     emulator.init();
+#ifdef BENCHMARK
+    Benchmark::run();
+#endif
 
 #ifdef NETWORK_SSID_SCAN
     WiFi.mode(WIFI_STA);
@@ -63,9 +81,7 @@ void setup() {
             Serial << beginl << "SSID: " << WiFi.SSID() << DI::endl;
             Serial << beginl << "IP address: " << WiFi.localIP() << DI::endl; 
             emulator.led.setState(LEDControl::LedState::LED_FLASH_FAST);
-            // start MQTT connection
-            if (mqtt.begin(BROKER_ADDR, BROKER_USERNAME, BROKER_PASSWORD))
-                Serial << beginl << "MQTT connecting... " << DI::endl;
+            emulator.markNetworkUp();
         } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
             // lost connection
             Serial << beginl << red << "Lost WiFi connection" << DI::endl;
@@ -83,48 +99,81 @@ void setup() {
     device.enableSharedAvailability();
     device.enableLastWill();
 
+    // MQTT connection is opened by the connection manager once WiFi is up
+    network.begin(BROKER_USERNAME, BROKER_PASSWORD);
+    Discovery::begin(mqtt);
+    if constexpr (httpStatusEnabled)
+        httpServer.begin();
+
 }
 
 void loop() {
-    static bool mqttStartup = false;
     static bool mqttConnected = false;
-    if (WiFi.status() == WL_CONNECTED) {
-        mqtt.loop();
-        bool connected = mqtt.isConnected();
-        if (mqttConnected != connected) {
-            mqttConnected = connected;
-            if (mqttConnected) {
-                emulator.led.setState(LEDControl::LedState::LED_ON);
-            } else {
-                emulator.led.setState(LEDControl::LedState::LED_FLASH_FAST);
-            }
-            Serial << beginl << (mqttConnected ? green : red) << "MQTT " << (mqttConnected ? "connected" : "disconnected") << DI::endl;
-            if (!mqttStartup) {
-                // publish initial state
-                mqttStartup = true;
-                status.setValue("N/A");
-                source.setValue("N/A");
-                message.setValue("N/A");
-            }
+    static uint32_t outageStart = 0;
+    network.loop();
+    bool connected = network.isConnected();
+    if (mqttConnected != connected) {
+        mqttConnected = connected;
+        if (mqttConnected) {
+            emulator.led.setState(LEDControl::LedState::LED_ON);
+        } else if (network.getState() != ConnectionManager::State::WifiConnecting) {
+            emulator.led.setState(LEDControl::LedState::LED_FLASH_FAST);
+        } else {
+            // WiFi lost, same as the WiFi disconnect event
+            emulator.led.setState(LEDControl::LedState::LED_FLASH_SLOW);
         }
+        Serial << beginl << (mqttConnected ? green : red) << "MQTT " << (mqttConnected ? "connected" : "disconnected") << DI::endl;
+        if (mqttConnected) {
+            // worst-case delay of the modem while the connection was down
+            Serial << beginl << "Outage " << millis() - outageStart << " ms, max modem loop gap: "
+                   << emulator.getModemLoopGap() / 1000 << " ms, connection attempts: " << network.getStats().attempts
+                   << ", overruns: " << network.getStats().overruns << ", max step: " << network.getStats().maxStep << " us" << DI::endl;
+            // reset after the report, so the next one includes the step that drops the connection
+            emulator.resetModemLoopGap();
+            Discovery::connected(mqtt);
+            // replay the cached status, events may have changed it during the outage
+            emulator.publishStatus(true);
+        } else {
+            outageStart = millis();
+        }
+    }
+    if constexpr (httpStatusEnabled) {
+        if (WiFi.status() == WL_CONNECTED)
+            httpServer.loop();
+    }
+    if (mqttConnected && Discovery::takeRequest()) {
+        Serial << beginl << "Home Assistant restarted, publish discovery" << DI::endl;
+        Discovery::setPublished(false);
+        status.republish();
+        updateCmd.republish();
+        armCmd.republish();
+        disarmCmd.republish();
+        Discovery::setPublished(true);
+        emulator.publishStatus(true);
+    }
+#if defined(BENCHMARK) && !defined(NATIVE)
+    // event storm needs the MQTT connection to measure the publish path
+    static bool eventStormDone = false;
+    if (mqttConnected && !eventStormDone) {
+        eventStormDone = true;
+        Benchmark::runEventStorm();
+        Benchmark::runSoak();
     }
+#endif
     emulator.loop();
 }
 
 void Emulator::init() {
 
     sim900.init();
+    led.begin();  // LED patterns are played by a timer, not from loop()
 
     status.setName("Status");
-    source.setName("Source");
-    message.setName("Message");
     updateCmd.setName("Update Status");
     armCmd.setName("Arm");
     disarmCmd.setName("Disarm");
 
     status.setIcon("mdi:alarm-panel");
-    source.setIcon("mdi:source-branch");
-    message.setIcon("mdi:message-text");
     updateCmd.setIcon("mdi:refresh");
     armCmd.setIcon("mdi:shield-lock");
     disarmCmd.setIcon("mdi:shield-lock-open");
@@ -135,16 +184,86 @@ void Emulator::init() {
 
     // request initial status
     sendCommand(Command::GetStatus);
+    pollTimer = millis();
+    pollPending = true;
 
 }
 
 bool Emulator::sendCommand(const Command cmd) {
+    if (cmd == Command::GetStatus) {
+        if (pendingStatus.valid || pendingMode.valid || inFlight.valid) {
+            // a pending or unconfirmed command will report the state
+            if (!pendingStatus.valid && !pendingMode.valid)
+                statusCoalesced = true;
+            queueStats.coalesced++;
+            Serial << beginl << "Status request coalesced with pending command" << DI::endl;
+            return true;
+        }
+        pendingStatus = PendingCommand{true, cmd, Trace::begin(), millis()};
+        return true;
+    }
+    if (pendingStatus.valid) {
+        pendingStatus.valid = false;
+        queueStats.superseded++;
+        Serial << beginl << "Pending status request dropped" << DI::endl;
+    }
+    if (pendingMode.valid) {
+        // latest arm/disarm request wins, keep the original queue time
+        queueStats.coalesced++;
+        pendingMode.cmd = cmd;
+        Serial << beginl << "Pending command replaced" << DI::endl;
+        return true;
+    }
+    pendingMode = PendingCommand{true, cmd, Trace::begin(), millis()};
+    return true;
+}
+
+void Emulator::dispatchCommand() {
+    if (inFlight.valid) {
+        if (millis() - inFlight.queuedAt < COMMAND_TIMEOUT)
+            return;
+        inFlight.valid = false;
+        Serial << beginl << red << "Command " << (int)inFlight.cmd << " not confirmed by the panel" << DI::endl;
+        // the cached state may be wrong, poll at the shortest interval
+        pollInterval = POLL_INTERVAL_MIN;
+        if (inFlight.cmd != Command::GetStatus || statusCoalesced) {
+            // re-request the state now, this also replaces a coalesced status request
+            statusCoalesced = false;
+            pollTimer = millis();
+            pollPending = true;
+            sendCommand(Command::GetStatus);
+        }
+    }
+    if (!sim900.readyToSend())
+        return;
+    PendingCommand* pending = pendingMode.valid ? &pendingMode
+                            : pendingStatus.valid ? &pendingStatus : nullptr;
+    if (pending == nullptr)
+        return;
+    pending->valid = false;
+    unsigned long wait = millis() - pending->queuedAt;
+    queueStats.sent++;
+    queueStats.totalWait += wait;
+    if (wait > queueStats.maxWait) queueStats.maxWait = wait;
+    Serial << beginl << "Send command " << (int)pending->cmd << ", waited " << wait << " ms"
+           << " (sent: " << queueStats.sent << ", coalesced: " << queueStats.coalesced
+           << ", superseded: " << queueStats.superseded << ", max wait: " << queueStats.maxWait << " ms)" << DI::endl;
+    if (!transmitCommand(*pending)) {
+        Serial << beginl << red << "Failed to send command: " << (int)pending->cmd << DI::endl;
+        return;
+    }
+    inFlight = *pending;
+    inFlight.valid = true;
+    inFlight.queuedAt = millis();
+}
+
+bool Emulator::transmitCommand(const PendingCommand &pending) {
     FixedString128 fs;
         fs = smsKey;
         fs += " ";
         fs += smsPin;
         fs += " ";
-    switch (cmd) {
+    switch (pending.cmd) {
         case Command::GetStatus:
             fs += "MOD?:";
             break;
@@ -160,11 +279,11 @@ bool Emulator::sendCommand(const Command cmd) {
         default:
             return false;
     }
-    return sim900.sendMessage(fs);
+    return sim900.sendMessage(fs.c_str(), pending.traceId);
 }
 
 Emulator::CommandState Emulator::parseCommandResponse(const FixedString128 &msg) {
-    char *modPos = strstr(msg.c_str(), "MOD?:");
+    const char *modPos = strstr(msg.c_str(), "MOD?:");
     if (modPos == nullptr) {
         modPos = strstr(msg.c_str(), "MODE:");
     }
@@ -182,14 +301,213 @@ Emulator::CommandState Emulator::parseCommandResponse(const FixedString128 &msg)
     return CommandState::Unknown;
 }
 
+void Emulator::updateStatus(const FixedString128 &value, bool stablePoll) {
+    bool changed = !statusValid || strcmp(currentStatus.c_str(), value.c_str()) != 0;
+    currentStatus.set(value.c_str());
+    statusUpdatedAt = millis();
+    statusValid = true;
+    // any status from the panel, also events, defers the next poll
+    pollTimer = statusUpdatedAt;
+    pollPending = false;
+    if (stablePoll && !changed) {
+        // back off while the state is stable
+        pollInterval = pollInterval * 2 > POLL_INTERVAL_MAX ? POLL_INTERVAL_MAX : pollInterval * 2;
+    } else {
+        pollInterval = POLL_INTERVAL_MIN;
+    }
+}
+
+void Emulator::pollStatus() {
+    if ((millis() - pollTimer) < pollInterval)
+        return;
+    if (pollPending) {
+        // no status received since the last poll
+        Serial << beginl << red << "Status poll failed" << DI::endl;
+        pollInterval = POLL_INTERVAL_MIN;
+    }
+    Serial << beginl << "Poll status, interval: " << pollInterval / 1000 << " s" << DI::endl;
+    pollTimer = millis();
+    pollPending = true;
+    sendCommand(Command::GetStatus);
+}
+
+// append string as JSON string literal, escaping quotes, backslashes and control characters
+template <size_t N>
+static void appendJsonString(FixedString<N> &out, const char* s) {
+    out.append('"');
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            out.append('\\');
+            out.append((char)c);
+        } else if (c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out.append(esc);
+        } else {
+            out.append((char)c);
+        }
+    }
+    out.append('"');
+}
+
+// state, sources, message and status age as JSON object members (without braces)
+template <size_t N>
+void Emulator::appendStatusFields(FixedString<N> &out) const {
+    char number[21];    // any 64-bit long
+    out.append("\"state\":");
+    appendJsonString(out, currentStatus.c_str());
+    out.append(",\"sources\":");
+    appendJsonString(out, lastSources.c_str());
+    out.append(",\"message\":");
+    appendJsonString(out, lastMessage.c_str());
+    // uptime in seconds when the message was received, -1: no message yet
+    snprintf(number, sizeof(number), "%ld", messageTime ? (long)(messageTime / 1000) : -1L);
+    out.append(",\"time\":");
+    out.append(number);
+    // number of events merged into this message by the aggregation window
+    snprintf(number, sizeof(number), "%u", (unsigned)messageCount);
+    out.append(",\"count\":");
+    out.append(number);
+    // age of the cached status in seconds, -1: no status received from the panel yet
+    snprintf(number, sizeof(number), "%ld", statusValid ? (long)(getStatusAge() / 1000) : -1L);
+    out.append(",\"age\":");
+    out.append(number);
+    out.append(",\"fresh\":");
+    out.append(isStatusFresh() ? "true" : "false");
+}
+
+void Emulator::publishStatus(bool force) {
+    // state, sources, message and status age are published in a single attributes payload,
+    // the state topic is only written if the state changed (or forced by keep-alive),
+    // attributes first, so HA sees consistent attributes when triggering on a state change.
+    // note: only an event with unchanged state is a single, atomic publish, on a state change
+    // attributes and state are two messages and HA briefly sees the new attributes with the
+    // old state, the "state" member of the attributes is always consistent with them
+    attributes.set("{");
+    appendStatusFields(attributes);
+    attributes.append('}');
+    bool sent = status.setJsonAttributes(attributes.c_str());
+    if (force || strcmp(publishedStatus.c_str(), currentStatus.c_str()) != 0) {
+        // remember the status only if it reached the broker, a reconnect publishes it anyway
+        sent = status.setValue(currentStatus.c_str()) && sent;
+        if (sent)
+            publishedStatus.set(currentStatus.c_str());
+    }
+    if (sent && statusValid && networkUpAt != 0) {
+        Serial << beginl << green << "First valid status published " << millis() - networkUpAt << " ms after WiFi got IP" << DI::endl;
+        networkUpAt = 0;
+    }
+    lastUpdate = millis();
+    eventStats.published++;
+    Serial << beginl << green << "MQTT Status: " << currentStatus << " " << attributes.c_str() << DI::endl;
+    led.indicate(3);  // flash LED to indicate status update
+}
+
+void Emulator::renderSnapshot(SnapshotText &out) const {
+    // numeric member of the metrics, appended after the object's first member
+    auto field = [&out](const char* name, unsigned long value) {
+        char number[21];    // any 64-bit long
+        snprintf(number, sizeof(number), "%lu", value);
+        out.append(",\"");
+        out.append(name);
+        out.append("\":");
+        out.append(number);
+    };
+    out.set("{");
+    appendStatusFields(out);
+    out.append(",\"metrics\":{\"uptime\":");
+    char number[21];    // any 64-bit long
+    snprintf(number, sizeof(number), "%lu", (unsigned long)(millis() / 1000));
+    out.append(number);
+    field("messages", eventStats.messages);
+    field("merged", eventStats.merged);
+    field("aggregated", eventStats.aggregated);
+    field("published", eventStats.published);
+    field("commands_sent", queueStats.sent);
+    field("commands_coalesced", queueStats.coalesced);
+    field("commands_superseded", queueStats.superseded);
+    field("command_max_wait", queueStats.maxWait);
+    field("sms_dropped", sim900.getDroppedMessages());
+    field("sms_overflows", sim900.getSmsOverflows());
+    field("modem_max_loop_gap", sim900.getMaxLoopGap());
+    field("poll_interval", pollInterval / 1000);
+    out.append(",\"mqtt_connected\":");
+    out.append(network.isConnected() ? "true" : "false");
+    field("mqtt_attempts", network.getStats().attempts);
+    field("mqtt_failures", network.getStats().failures);
+    out.append("}}");
+}
+
+// arm/disarm states, changes to or from these bypass the aggregation window
+static bool isModeStatus(const char* s) {
+    return strcmp(s, "Scharf") == 0 || strcmp(s, "Unscharf") == 0;
+}
+
+// append source to a comma separated list unless already contained
+template <size_t N>
+static void appendSource(FixedString<N> &list, const char* source) {
+    size_t n = strlen(source);
+    const char* p = list.c_str();
+    while (*p) {
+        const char* end = strstr(p, ", ");
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == n && strncmp(p, source, n) == 0)
+            return;
+        if (!end) break;
+        p = end + 2;
+    }
+    if (list.length() > 0) list.append(", ");
+    list.append(source);
+}
+
+void Emulator::applyEvent(const char* message, const char* sources, const FixedString128 &value,
+                          bool stablePoll, uint16_t count, unsigned long time) {
+    lastMessage.set(message);
+    messageTime = time;
+    messageCount = count;
+    if (*sources) {
+        lastSources.set(sources);
+        Serial << beginl << green << "Sources: " << lastSources.c_str() << DI::endl;
+    }
+    if (value.length() > 0) {
+        updateStatus(value, stablePoll);
+    }
+}
+
+// publish the events merged within the aggregation window
+void Emulator::flushEvents() {
+    if (aggregate.count == 0)
+        return;
+    eventStats.aggregated++;
+    Serial << beginl << "Aggregated " << aggregate.count << " events (raw: " << eventStats.messages
+           << ", merged: " << eventStats.merged << ", aggregated: " << eventStats.aggregated << ")" << DI::endl;
+    // the status is only applied if one of the merged events reported one
+    applyEvent(aggregate.message.c_str(), aggregate.sources.c_str(), aggregate.status, false,
+               aggregate.count, aggregate.time);
+    aggregate.count = 0;
+    aggregate.status.clear();
+    aggregate.start = millis();
+    publishStatus();
+}
+
 void Emulator::loop() {
+    pollStatus();
+    dispatchCommand();
     sim900.loop();
-    led.loop();
     bool sendUpdate = false;
-    FixedString128 msg;
-    if (sim900.getMessage(msg)) {
+    uint16_t traceId = 0;
+    if (aggregate.open && (millis() - aggregate.start) >= AGGREGATION_WINDOW) {
+        // window closed, publish merged events, which starts a new window
+        if (aggregate.count > 0)
+            flushEvents();
+        else
+            aggregate.open = false;
+    }
+    if (sim900.getMessage(messageText, traceId)) {
+        const SmsText &msg = messageText;
+        eventStats.messages++;
         Serial << beginl << blue << "MQTT message: " << msg << DI::endl;
-        message.setValue(msg.c_str());
         // parse message as tuples: source|status|source|status|...
         // e.g. "FB Handsender|Scharf"
         //      "BW Flur|Einbruch"
@@ -216,6 +534,7 @@ void Emulator::loop() {
             int statStart = pos;
             while (pos < len && s[pos] != '|') ++pos;
             int statEnd = pos - 1;
+            if (pos < len) ++pos; // skip '|' before the next source
             // trim status
             while (statStart <= statEnd && isspace((unsigned char)s[statStart])) ++statStart;
             while (statEnd >= statStart && isspace((unsigned char)s[statEnd])) --statEnd;
@@ -258,11 +577,16 @@ void Emulator::loop() {
             }
             ++srcIdx;
         }
-        // note: observe order, set source first, then status,
-        // to allow HA to read up-to-date sources when triggering on status change
+        bool stablePoll = false;
+        bool reply = false;
         if (!sources.empty()) {
             // check if this is a response to a previous command
             if (sources.size() == 1 && sources[0].startsWith("Confirmed")) {
+                reply = true;
+                inFlight.valid = false;
+                statusCoalesced = false;
+                // status request replies allow to back off polling, arm/disarm replies don't
+                stablePoll = strstr(statusValue.c_str(), "MOD?:") != nullptr;
                 sources.clear();
                 sources.push_back(FixedString128("Kommandobestaetigung"));
                 auto cmdState = parseCommandResponse(statusValue);
@@ -276,30 +600,68 @@ void Emulator::loop() {
                         break;
                     case CommandState::Unknown:
                         statusValue.set("Unbekannt");
+                        stablePoll = false;
                         break;
                 }
             }
-            // join sources with comma into a FixedString128
-            FixedString128 sourcesList;
-            for (size_t i = 0; i < sources.size(); ++i) {
-                if (i > 0) sourcesList.append(", ");
-                sourcesList.append(sources[i].c_str());
-            }
-            source.setValue(sourcesList.c_str());
-            Serial << beginl << green << "MQTT Sources: " << sourcesList.c_str() << DI::endl;
         }
-        if (statusValue.length() > 0) {
-            currentStatus.set(statusValue.c_str());
+        // the modem assigns the command's trace to the next SMS from the panel, only the
+        // confirmation takes it, another SMS sent in between must not bypass the aggregation
+        if (reply) {
+            if (traceId == 0)
+                traceId = replyTrace;
+            replyTrace = 0;
+        } else if (traceId != 0) {
+            replyTrace = traceId;
+            traceId = 0;
+        }
+        Trace::hop(traceId, Trace::Hop::Parsed);
+        // compare with the latest status, merged or published
+        const FixedString128 &latest = aggregate.status.length() > 0 ? aggregate.status : currentStatus;
+        bool modeChange = statusValue.length() > 0 && strcmp(statusValue.c_str(), latest.c_str()) != 0 &&
+                          (isModeStatus(statusValue.c_str()) || isModeStatus(latest.c_str()));
+        bool windowOpen = aggregate.open && (millis() - aggregate.start) < AGGREGATION_WINDOW;
+        if (windowOpen && !reply && !modeChange) {
+            // merge into the pending aggregate, published when the window closes
+            if (aggregate.count == 0) {
+                aggregate.sources.clear();
+                aggregate.status.clear();
+            }
+            aggregate.count++;
+            aggregate.time = millis();
+            aggregate.message.set(msg.c_str());
+            if (statusValue.length() > 0)
+                aggregate.status.set(statusValue.c_str());
+            for (const auto &src : sources)
+                appendSource(aggregate.sources, src.c_str());
+            eventStats.merged++;
+        } else {
+            // publish merged events first to keep the order
+            flushEvents();
+            eventSources.clear();
+            for (const auto &src : sources)
+                appendSource(eventSources, src.c_str());
+            applyEvent(msg.c_str(), eventSources.c_str(), statusValue, stablePoll, 1, millis());
+            aggregate.open = AGGREGATION_WINDOW > 0;
+            aggregate.start = millis();
             sendUpdate = true;
         }
     }
+    bool keepAlive = false;
     if ((millis() - lastUpdate) > MQTT_KEEP_ALIVE) {
-        lastUpdate = millis();
+        keepAlive = true;
         sendUpdate = true;
     }
     if (sendUpdate) {
-        status.setValue(currentStatus.c_str());
-        Serial << beginl << green << "MQTT Status: " << currentStatus << DI::endl;
-        led.indicate(3);  // flash LED to indicate status update
+        publishStatus(keepAlive);
+        if (traceId != 0) {
+            Trace::hop(traceId, Trace::Hop::Published);
+#ifdef NATIVE
+            if (!Trace::save())
+                Serial << beginl << red << "Can't write " << Trace::TRACE_FILE << DI::endl;
+#else
+            Trace::dump(Serial, traceId);
+#endif
+        }
     }
 }
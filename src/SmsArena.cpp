@@ -0,0 +1,80 @@
+#include "SmsArena.h"
+
+static_assert(SmsArena::BLOCK_COUNT < SmsHandle::NONE, "block index must fit into the handle");
+
+SmsArena::SmsArena() {
+    // chain all blocks into the free list
+    for (size_t i = 0; i < BLOCK_COUNT; ++i) {
+        blocks[i].next = (i + 1 < BLOCK_COUNT) ? (uint8_t)(i + 1) : SmsHandle::NONE;
+    }
+    freeList = 0;
+    freeCount = BLOCK_COUNT;
+}
+
+uint8_t SmsArena::allocBlock() {
+    uint8_t b = freeList;
+    if (b != SmsHandle::NONE) {
+        freeList = blocks[b].next;
+        blocks[b].next = SmsHandle::NONE;
+        --freeCount;
+    }
+    return b;
+}
+
+bool SmsArena::append(SmsHandle &h, const char* s, size_t n) {
+    bool truncated = false;
+    if (h.length + n > SMS_MAX_LENGTH) {
+        n = SMS_MAX_LENGTH - h.length;
+        truncated = true;
+    }
+    while (n > 0) {
+        size_t used = h.length % BLOCK_SIZE;
+        if (!h.valid() || used == 0) {
+            // tail block full (or none yet), chain a new one
+            uint8_t b = allocBlock();
+            if (b == SmsHandle::NONE) {
+                truncated = true;
+                break;
+            }
+            if (h.valid())
+                blocks[h.tail].next = b;
+            else
+                h.head = b;
+            h.tail = b;
+        }
+        size_t toCopy = BLOCK_SIZE - used;
+        if (toCopy > n) toCopy = n;
+        memcpy(blocks[h.tail].data + used, s, toCopy);
+        h.length += toCopy;
+        s += toCopy;
+        n -= toCopy;
+    }
+    if (truncated && !h.truncated) {
+        h.truncated = true;
+        ++overflows;
+    }
+    return !truncated;
+}
+
+void SmsArena::release(SmsHandle &h) {
+    uint8_t b = h.head;
+    while (b != SmsHandle::NONE) {
+        uint8_t next = blocks[b].next;
+        blocks[b].next = freeList;
+        freeList = b;
+        ++freeCount;
+        b = next;
+    }
+    h = SmsHandle();
+}
+
+size_t SmsArena::copy(const SmsHandle &h, char* out, size_t size) const {
+    size_t len = 0;
+    forEachChunk(h, [&](const char* data, size_t n) {
+        if (len + n > size - 1) n = size - 1 - len;
+        memcpy(out + len, data, n);
+        len += n;
+    });
+    out[len] = '\0';
+    return len;
+}
@@ -0,0 +1,134 @@
+#include "StatusServer.h"
+#include "DebugInterface.h"
+#include <lwip/sockets.h>
+
+// debug output module identifier
+static inline Print& beginl(Print &stream) {
+    static constexpr const char name[] = "HTTP";
+    return beginl<name>(stream);
+}
+
+void StatusServer::begin() {
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener < 0) {
+        Serial << beginl << red << "No socket for the status endpoint" << DI::endl;
+        return;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+#ifdef NATIVE
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+#else
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+#endif
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, MAX_CLIENTS) < 0) {
+        Serial << beginl << red << "Status endpoint can't listen on port " << port << DI::endl;
+        ::close(listener);
+        listener = -1;
+        return;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+    Serial << beginl << "Status endpoint on port " << port << DI::endl;
+}
+
+void StatusServer::loop() {
+    if (listener < 0)
+        return;
+    accept();
+    for (auto &c : connections) {
+        if (c.fd >= 0)
+            serve(c);
+    }
+}
+
+void StatusServer::accept() {
+    for (auto &c : connections) {
+        if (c.fd >= 0)
+            continue;
+        // only accept with a free slot, other clients stay in the backlog
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        c.fd = fd;
+        c.start = millis();
+        c.requestLine.clear();
+        c.lineDone = false;
+        c.newlines = 0;
+        return;
+    }
+}
+
+void StatusServer::serve(Connection &c) {
+    if (millis() - c.start >= REQUEST_TIMEOUT) {
+        close(c);
+        return;
+    }
+    char data[MAX_READ];
+    ssize_t n = recv(c.fd, data, sizeof(data), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close(c);   // closed by the client
+        return;
+    }
+    // request line is kept, the rest of the header is only scanned for its end
+    for (ssize_t i = 0; i < n; ++i) {
+        char ch = data[i];
+        if (ch == '\r')
+            continue;
+        if (ch == '\n') {
+            c.lineDone = true;
+            if (++c.newlines == 2) {
+                respond(c);
+                return;
+            }
+            continue;
+        }
+        c.newlines = 0;
+        if (!c.lineDone)
+            c.requestLine.append(ch);
+    }
+}
+
+void StatusServer::respond(Connection &c) {
+    requests++;
+    const char* path = c.requestLine.startsWith("GET ") ? c.requestLine.c_str() + 4 : "";
+    bool found = strncmp(path, "/ ", 2) == 0 || strncmp(path, "/status ", 8) == 0;
+    char header[128];
+    if (found) {
+        emulator.renderSnapshot(body);
+        snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                 "Content-Length: %u\r\nConnection: close\r\n\r\n", (unsigned)body.length());
+    } else {
+        snprintf(header, sizeof(header), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    }
+    send(c, header, strlen(header));
+    if (found)
+        send(c, body.c_str(), body.length());
+    close(c);
+}
+
+// the response fits into the send buffer of a new connection, the rest is dropped
+void StatusServer::send(Connection &c, const char* data, size_t length) {
+    if (c.fd < 0)
+        return;
+    int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+    if (::send(c.fd, data, length, flags) != (ssize_t)length) {
+        Serial << beginl << red << "Response cut off" << DI::endl;
+        close(c);
+    }
+}
+
+void StatusServer::close(Connection &c) {
+    if (c.fd >= 0)
+        ::close(c.fd);
+    c.fd = -1;
+}
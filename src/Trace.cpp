@@ -0,0 +1,93 @@
+#include "Trace.h"
+#include <PrintStream.h>
+#ifdef NATIVE
+#include <cstdio>
+#endif
+
+Trace::Event Trace::ring[Trace::RING_SIZE];
+size_t Trace::head = 0;
+size_t Trace::count = 0;
+uint16_t Trace::nextId = 1;
+
+uint16_t Trace::begin() {
+    if constexpr (!traceEnabled)
+        return 0;
+    uint16_t id = nextId++;
+    if (nextId == 0) nextId = 1;  // 0 is reserved for "no trace"
+    hop(id, Hop::Request);
+    return id;
+}
+
+void Trace::hop(uint16_t id, Hop hop) {
+    if constexpr (!traceEnabled)
+        return;
+    if (id == 0)
+        return;
+    ring[head] = Event{id, hop, (uint32_t)micros()};
+    head = (head + 1) % RING_SIZE;
+    if (count < RING_SIZE) ++count;
+}
+
+// name of the span ending with the given hop
+const char* Trace::spanName(Hop hop) {
+    switch (hop) {
+        case Hop::Indicated: return "tx_queue";
+        case Hop::Read:      return "panel_fetch";
+        case Hop::Reply:     return "panel_process";
+        case Hop::Received:  return "sms_receive";
+        case Hop::Parsed:    return "rx_queue";
+        case Hop::Published: return "publish";
+        default:             return "request";
+    }
+}
+
+void Trace::dump(Print &out, uint16_t id) {
+    out << "TRACE_JSON ";
+    writeSpans(out, id);
+    out << "\n";
+}
+
+#ifdef NATIVE
+// Print to a stdio file
+class FilePrint : public Print {
+public:
+    explicit FilePrint(FILE* file) : file(file) {}
+    size_t write(uint8_t c) override { return fputc(c, file) != EOF; }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, file); }
+private:
+    FILE* file;
+};
+
+bool Trace::save(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+    FilePrint out(file);
+    writeSpans(out, 0);
+    return fclose(file) == 0;
+}
+#endif
+
+// spans as trace-event JSON array, id 0: all traces
+void Trace::writeSpans(Print &out, uint16_t id) {
+    out << "[";
+    bool first = true;
+    size_t start = (head + RING_SIZE - count) % RING_SIZE;
+    for (size_t i = 1; i < count; ++i) {
+        const Event &e = ring[(start + i) % RING_SIZE];
+        if (id != 0 && e.id != id)
+            continue;
+        // find the previous hop of the same trace
+        for (size_t j = i; j-- > 0; ) {
+            const Event &prev = ring[(start + j) % RING_SIZE];
+            if (prev.id != e.id)
+                continue;
+            if (!first) out << ",";
+            first = false;
+            out << "{\"name\":\"" << spanName(e.hop) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (unsigned)e.id
+                << ",\"ts\":" << prev.timestamp << ",\"dur\":" << (uint32_t)(e.timestamp - prev.timestamp) << "}";
+            break;
+        }
+    }
+    out << "]";
+}
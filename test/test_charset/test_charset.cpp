@@ -0,0 +1,182 @@
+#include <unity.h>
+#include "Charset.h"
+
+using Charset::Type;
+
+void setUp() {}
+void tearDown() {}
+
+template <size_t N>
+static void decodeText(Type type, const char* in, FixedString<N> &out) {
+    out.clear();
+    Charset::decode(type, in, out);
+}
+
+template <size_t N>
+static void encodeText(Type type, const char* in, FixedString<N> &out) {
+    out.clear();
+    Charset::encode(type, in, out);
+}
+
+static void test_gsm_escape_round_trip() {
+    static constexpr char text[] = "{[€]}\\~|^";
+    FixedString128 gsm;
+    FixedString128 utf8;
+    encodeText(Type::GSM, text, gsm);
+    // each character is an escape sequence
+    TEST_ASSERT_EQUAL(2 * 9, gsm.length());
+    TEST_ASSERT_EQUAL('\x1B', gsm.c_str()[0]);
+    TEST_ASSERT_EQUAL(0x28, gsm.c_str()[1]);
+    decodeText(Type::GSM, gsm.c_str(), utf8);
+    TEST_ASSERT_EQUAL_STRING(text, utf8.c_str());
+}
+
+static void test_gsm_escape_incomplete() {
+    FixedString128 utf8;
+    decodeText(Type::GSM, "AB\x1B", utf8);
+    TEST_ASSERT_EQUAL_STRING("AB", utf8.c_str());
+    // unknown extension character
+    decodeText(Type::GSM, "A\x1B" "AB", utf8);
+    TEST_ASSERT_EQUAL_STRING("A B", utf8.c_str());
+}
+
+static void test_gsm_escape_not_split() {
+    // no room for the complete escape sequence, nothing follows
+    FixedString<4> gsm;
+    encodeText(Type::GSM, "ab€c", gsm);
+    TEST_ASSERT_EQUAL_STRING("ab", gsm.c_str());
+}
+
+static void test_gsm_at_placeholder_round_trip() {
+    FixedString128 gsm;
+    FixedString128 utf8;
+    encodeText(Type::GSM, "@a@b@", gsm);
+    TEST_ASSERT_EQUAL(5, gsm.length());
+    TEST_ASSERT_EQUAL(Charset::GSM_AT_PLACEHOLDER, gsm.c_str()[0]);
+    TEST_ASSERT_EQUAL(Charset::GSM_AT_PLACEHOLDER, gsm.c_str()[4]);
+    decodeText(Type::GSM, gsm.c_str(), utf8);
+    TEST_ASSERT_EQUAL_STRING("@a@b@", utf8.c_str());
+}
+
+static void test_gsm_national_characters() {
+    FixedString128 gsm;
+    FixedString128 utf8;
+    encodeText(Type::GSM, "Küche|Öl ΔΩ", gsm);
+    decodeText(Type::GSM, gsm.c_str(), utf8);
+    TEST_ASSERT_EQUAL_STRING("Küche|Öl ΔΩ", utf8.c_str());
+    // not in the GSM alphabet
+    encodeText(Type::GSM, "a€b漢", gsm);
+    decodeText(Type::GSM, gsm.c_str(), utf8);
+    TEST_ASSERT_EQUAL_STRING("a€b?", utf8.c_str());
+}
+
+static void test_line_breaks() {
+    FixedString128 utf8;
+    decodeText(Type::GSM, "BW Flur\r\nEinbruch", utf8);
+    TEST_ASSERT_EQUAL_STRING("BW Flur|Einbruch", utf8.c_str());
+    decodeText(Type::UCS2, "0041000D000A0042", utf8);
+    TEST_ASSERT_EQUAL_STRING("A|B", utf8.c_str());
+}
+
+static void test_ucs2_round_trip() {
+    FixedString128 ucs2;
+    FixedString128 utf8;
+    encodeText(Type::UCS2, "Küche €", ucs2);
+    TEST_ASSERT_EQUAL_STRING("004B00FC006300680065002020AC", ucs2.c_str());
+    decodeText(Type::UCS2, ucs2.c_str(), utf8);
+    TEST_ASSERT_EQUAL_STRING("Küche €", utf8.c_str());
+    // lower case hex digits
+    decodeText(Type::UCS2, "00fc", utf8);
+    TEST_ASSERT_EQUAL_STRING("ü", utf8.c_str());
+}
+
+static void test_ucs2_odd_length() {
+    FixedString128 utf8;
+    // incomplete code units at the end are ignored
+    decodeText(Type::UCS2, "0041004", utf8);
+    TEST_ASSERT_EQUAL_STRING("A", utf8.c_str());
+    decodeText(Type::UCS2, "004100420", utf8);
+    TEST_ASSERT_EQUAL_STRING("AB", utf8.c_str());
+    decodeText(Type::UCS2, "004", utf8);
+    TEST_ASSERT_EQUAL_STRING("", utf8.c_str());
+    // decoding stops at an invalid digit
+    decodeText(Type::UCS2, "0041XY420043", utf8);
+    TEST_ASSERT_EQUAL_STRING("A", utf8.c_str());
+}
+
+static void test_ucs2_surrogate_pair() {
+    FixedString128 ucs2;
+    FixedString128 utf8;
+    decodeText(Type::UCS2, "0041D83DDE000042", utf8);
+    TEST_ASSERT_EQUAL_STRING("A\xF0\x9F\x98\x80" "B", utf8.c_str());
+    encodeText(Type::UCS2, utf8.c_str(), ucs2);
+    TEST_ASSERT_EQUAL_STRING("0041D83DDE000042", ucs2.c_str());
+}
+
+static void test_ucs2_unpaired_surrogates() {
+    FixedString128 utf8;
+    decodeText(Type::UCS2, "D83D0041", utf8);      // high without low
+    TEST_ASSERT_EQUAL_STRING("?A", utf8.c_str());
+    decodeText(Type::UCS2, "DE000041", utf8);      // low without high
+    TEST_ASSERT_EQUAL_STRING("?A", utf8.c_str());
+    decodeText(Type::UCS2, "0041D83D", utf8);      // high at the end
+    TEST_ASSERT_EQUAL_STRING("A?", utf8.c_str());
+    decodeText(Type::UCS2, "D83DD83DDE00", utf8);  // high followed by a pair
+    TEST_ASSERT_EQUAL_STRING("?\xF0\x9F\x98\x80", utf8.c_str());
+    // surrogate code points in UTF-8 input can't be encoded
+    FixedString128 ucs2;
+    encodeText(Type::UCS2, "\xED\xA0\xBD", ucs2);
+    TEST_ASSERT_EQUAL_STRING("003F", ucs2.c_str());
+}
+
+static void test_ucs2_surrogate_pair_not_split() {
+    // room for 11 characters, one more code unit but not the pair
+    FixedString<12> ucs2;
+    encodeText(Type::UCS2, "A\xF0\x9F\x98\x80", ucs2);
+    TEST_ASSERT_EQUAL_STRING("0041", ucs2.c_str());
+}
+
+static void test_utf8_not_split() {
+    // room for 5 bytes: the third 2-byte character doesn't fit, nothing follows
+    FixedString<6> utf8;
+    decodeText(Type::UCS2, "00FC00FC00FC0041", utf8);
+    TEST_ASSERT_EQUAL_STRING("üü", utf8.c_str());
+    TEST_ASSERT_EQUAL(4, utf8.length());
+}
+
+static void test_ira() {
+    FixedString128 out;
+    encodeText(Type::IRA, "Küche", out);
+    TEST_ASSERT_EQUAL_STRING("K?che", out.c_str());
+    decodeText(Type::IRA, "K\xFC" "che", out);
+    TEST_ASSERT_EQUAL_STRING("K?che", out.c_str());
+}
+
+static void test_parse() {
+    Type type = Type::IRA;
+    TEST_ASSERT_TRUE(Charset::parse("\"UCS2\"", type));
+    TEST_ASSERT_TRUE(type == Type::UCS2);
+    TEST_ASSERT_TRUE(Charset::parse("GSM", type));
+    TEST_ASSERT_TRUE(type == Type::GSM);
+    TEST_ASSERT_FALSE(Charset::parse("\"HEX\"", type));
+    TEST_ASSERT_TRUE(type == Type::GSM);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_gsm_escape_round_trip);
+    RUN_TEST(test_gsm_escape_incomplete);
+    RUN_TEST(test_gsm_escape_not_split);
+    RUN_TEST(test_gsm_at_placeholder_round_trip);
+    RUN_TEST(test_gsm_national_characters);
+    RUN_TEST(test_line_breaks);
+    RUN_TEST(test_ucs2_round_trip);
+    RUN_TEST(test_ucs2_odd_length);
+    RUN_TEST(test_ucs2_surrogate_pair);
+    RUN_TEST(test_ucs2_unpaired_surrogates);
+    RUN_TEST(test_ucs2_surrogate_pair_not_split);
+    RUN_TEST(test_utf8_not_split);
+    RUN_TEST(test_ira);
+    RUN_TEST(test_parse);
+    return UNITY_END();
+}
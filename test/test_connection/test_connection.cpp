@@ -0,0 +1,96 @@
+#include <unity.h>
+#include <cstdio>
+#include <LoopbackBroker.h>
+#include <WiFi.h>
+#include "ConnectionManager.h"
+#include "Sim900Emulator.h"
+
+// the emulator's main loop against the broker stand-in in real time, each outage has to
+// keep the modem served, the longest gap between modem loop calls is reported
+void setup();
+void loop();
+extern ConnectionManager network;
+extern Emulator emulator;
+
+static LoopbackBroker broker;
+
+static constexpr uint32_t RECONNECT_WAIT = 10000 + 2500 + 1000;    // first backoff with jitter
+static constexpr uint32_t SESSION_GAP_MAX = 20000;  // microseconds, steps within NETWORK_BUDGET
+static constexpr uint32_t SETUP_GAP_MAX = 120000;   // microseconds, CONNACK_TIMEOUT
+
+void setUp() {
+    emulator.resetModemLoopGap();
+}
+void tearDown() {}
+
+// runs the main loop until done() or the timeout in milliseconds, true if done
+template <typename Done>
+static bool runUntil(uint32_t timeout, Done done) {
+    uint32_t start = millis();
+    while (millis() - start < timeout) {
+        loop();
+        if (done())
+            return true;
+    }
+    return false;
+}
+
+static void reportGap(const char* outage) {
+    char text[64];
+    snprintf(text, sizeof(text), "%s: max loop gap %u us", outage, (unsigned)emulator.getModemLoopGap());
+    TEST_MESSAGE(text);
+}
+
+static bool backoff() { return network.getState() == ConnectionManager::State::Backoff; }
+static bool connected() { return network.isConnected(); }
+
+// the broker accepts the TCP connection but never answers CONNECT
+static void test_connack_stall() {
+    broker.setMode(LoopbackBroker::Mode::Stall);
+    WiFi.setStatus(WL_CONNECTED);
+    setup();
+    TEST_ASSERT_TRUE(runUntil(1000, backoff));
+    TEST_ASSERT_EQUAL(1, network.getStats().failures);
+    reportGap("CONNACK stall");
+    TEST_ASSERT_LESS_OR_EQUAL(SETUP_GAP_MAX, emulator.getModemLoopGap());
+}
+
+static void test_reconnect() {
+    broker.setMode(LoopbackBroker::Mode::Up);
+    TEST_ASSERT_TRUE(runUntil(RECONNECT_WAIT, connected));
+    reportGap("backoff");
+    TEST_ASSERT_LESS_OR_EQUAL(SETUP_GAP_MAX, emulator.getModemLoopGap());
+}
+
+// the broker stops reading, the session is kept until the keep-alive expires
+static void test_session_stall() {
+    broker.setMode(LoopbackBroker::Mode::Stall);
+    runUntil(2000, [] { return !network.isConnected(); });
+    TEST_ASSERT_TRUE(network.isConnected());
+    reportGap("session stall");
+    TEST_ASSERT_LESS_OR_EQUAL(SESSION_GAP_MAX, emulator.getModemLoopGap());
+}
+
+// the broker closes the session and refuses connections, then comes back
+static void test_broker_down() {
+    broker.setMode(LoopbackBroker::Mode::Down);
+    TEST_ASSERT_TRUE(runUntil(1000, backoff));
+    runUntil(1000, [] { return false; });
+    broker.setMode(LoopbackBroker::Mode::Up);
+    TEST_ASSERT_TRUE(runUntil(RECONNECT_WAIT, connected));
+    reportGap("broker down");
+    TEST_ASSERT_LESS_OR_EQUAL(SESSION_GAP_MAX, emulator.getModemLoopGap());
+}
+
+int main() {
+    if (!broker.begin())
+        return 1;
+    UNITY_BEGIN();
+    RUN_TEST(test_connack_stall);
+    RUN_TEST(test_reconnect);
+    RUN_TEST(test_session_stall);
+    RUN_TEST(test_broker_down);
+    int failures = UNITY_END();
+    broker.end();
+    return failures;
+}
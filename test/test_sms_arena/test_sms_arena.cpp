@@ -0,0 +1,162 @@
+#include <unity.h>
+#include "SmsArena.h"
+
+static constexpr size_t BLOCK = SmsArena::BLOCK_SIZE;
+
+void setUp() {}
+void tearDown() {}
+
+// text of the given length, 'a' to 'z' repeated
+static const char* pattern(size_t n) {
+    static char text[2 * SMS_MAX_LENGTH + 1];
+    for (size_t i = 0; i < n; ++i) text[i] = 'a' + i % 26;
+    text[n] = '\0';
+    return text;
+}
+
+static size_t usedBlocks(const SmsArena &arena) {
+    return SmsArena::BLOCK_COUNT - arena.getFreeBlocks();
+}
+
+static void test_block_chaining_exact_multiples() {
+    SmsArena arena;
+    SmsHandle h;
+    TEST_ASSERT_TRUE(arena.append(h, pattern(BLOCK), BLOCK));
+    TEST_ASSERT_EQUAL(1, usedBlocks(arena));
+    TEST_ASSERT_TRUE(h.head == h.tail);
+    // a full tail block chains the next one on the next append only
+    TEST_ASSERT_TRUE(arena.append(h, pattern(2 * BLOCK) + BLOCK, BLOCK));
+    TEST_ASSERT_EQUAL(2, usedBlocks(arena));
+    TEST_ASSERT_TRUE(arena.append(h, pattern(2 * BLOCK + 1) + 2 * BLOCK, 1));
+    TEST_ASSERT_EQUAL(3, usedBlocks(arena));
+    TEST_ASSERT_EQUAL(2 * BLOCK + 1, h.length);
+
+    SmsText text;
+    TEST_ASSERT_EQUAL(2 * BLOCK + 1, arena.copy(h, text));
+    TEST_ASSERT_EQUAL_STRING(pattern(2 * BLOCK + 1), text.c_str());
+    arena.release(h);
+    TEST_ASSERT_EQUAL(0, usedBlocks(arena));
+    TEST_ASSERT_FALSE(h.valid());
+}
+
+static void test_appends_across_blocks() {
+    SmsArena arena;
+    SmsHandle h;
+    const char* text = pattern(3 * BLOCK);
+    // pieces not aligned to the block size, ending on a block boundary
+    TEST_ASSERT_TRUE(arena.append(h, text, 20));
+    TEST_ASSERT_TRUE(arena.append(h, text + 20, 20));
+    TEST_ASSERT_TRUE(arena.append(h, text + 40, 3 * BLOCK - 40));
+    TEST_ASSERT_EQUAL(3, usedBlocks(arena));
+
+    size_t chunks = 0;
+    size_t total = 0;
+    arena.forEachChunk(h, [&](const char* data, size_t n) {
+        TEST_ASSERT_EQUAL(BLOCK, n);
+        TEST_ASSERT_EQUAL_MEMORY(text + total, data, n);
+        total += n;
+        chunks++;
+    });
+    TEST_ASSERT_EQUAL(3, chunks);
+    TEST_ASSERT_EQUAL(3 * BLOCK, total);
+}
+
+static void test_empty_append() {
+    SmsArena arena;
+    SmsHandle h;
+    TEST_ASSERT_TRUE(arena.append(h, "", 0));
+    TEST_ASSERT_FALSE(h.valid());
+    TEST_ASSERT_EQUAL(0, usedBlocks(arena));
+    SmsText text("x");
+    TEST_ASSERT_EQUAL(0, arena.copy(h, text));
+    TEST_ASSERT_EQUAL_STRING("", text.c_str());
+}
+
+static void test_max_length_clamp() {
+    SmsArena arena;
+    SmsHandle h;
+    TEST_ASSERT_FALSE(arena.append(h, pattern(SMS_MAX_LENGTH + 10), SMS_MAX_LENGTH + 10));
+    TEST_ASSERT_EQUAL(SMS_MAX_LENGTH, h.length);
+    TEST_ASSERT_TRUE(h.truncated);
+    TEST_ASSERT_EQUAL((SMS_MAX_LENGTH + BLOCK - 1) / BLOCK, usedBlocks(arena));
+    // a full body takes nothing more
+    TEST_ASSERT_FALSE(arena.append(h, "x", 1));
+    TEST_ASSERT_EQUAL(SMS_MAX_LENGTH, h.length);
+
+    SmsText text;
+    TEST_ASSERT_EQUAL(SMS_MAX_LENGTH, arena.copy(h, text));
+    TEST_ASSERT_EQUAL_STRING(pattern(SMS_MAX_LENGTH), text.c_str());
+}
+
+static void test_max_length_exact() {
+    SmsArena arena;
+    SmsHandle h;
+    TEST_ASSERT_TRUE(arena.append(h, pattern(SMS_MAX_LENGTH), SMS_MAX_LENGTH));
+    TEST_ASSERT_FALSE(h.truncated);
+    TEST_ASSERT_EQUAL(0, arena.getOverflows());
+}
+
+static void test_overflow_counted_once_per_body() {
+    SmsArena arena;
+    SmsHandle a;
+    SmsHandle b;
+    arena.append(a, pattern(SMS_MAX_LENGTH), SMS_MAX_LENGTH);
+    TEST_ASSERT_FALSE(arena.append(a, "x"));
+    TEST_ASSERT_FALSE(arena.append(a, "y"));
+    TEST_ASSERT_FALSE(arena.append(a, "z"));
+    TEST_ASSERT_EQUAL(1, arena.getOverflows());
+    TEST_ASSERT_FALSE(arena.append(b, pattern(SMS_MAX_LENGTH + 1), SMS_MAX_LENGTH + 1));
+    TEST_ASSERT_EQUAL(2, arena.getOverflows());
+    // a released handle starts a new body
+    arena.release(a);
+    TEST_ASSERT_FALSE(a.truncated);
+    TEST_ASSERT_FALSE(arena.append(a, pattern(SMS_MAX_LENGTH + 1), SMS_MAX_LENGTH + 1));
+    TEST_ASSERT_EQUAL(3, arena.getOverflows());
+}
+
+static void test_exhausted_arena() {
+    static constexpr size_t BODY_BLOCKS = (SMS_MAX_LENGTH + BLOCK - 1) / BLOCK;
+    static constexpr size_t BODIES = SmsArena::BLOCK_COUNT / BODY_BLOCKS + 1;
+    SmsArena arena;
+    SmsHandle h[BODIES];
+    for (size_t i = 0; i < BODIES - 1; ++i)
+        TEST_ASSERT_TRUE(arena.append(h[i], pattern(SMS_MAX_LENGTH), SMS_MAX_LENGTH));
+    // the last body gets the remaining blocks, the overflow is counted once
+    size_t remaining = arena.getFreeBlocks();
+    for (size_t i = 0; i < SMS_MAX_LENGTH; i += 100)
+        arena.append(h[BODIES - 1], pattern(100), 100);
+    TEST_ASSERT_EQUAL(0, arena.getFreeBlocks());
+    TEST_ASSERT_EQUAL(remaining * BLOCK, h[BODIES - 1].length);
+    TEST_ASSERT_TRUE(h[BODIES - 1].truncated);
+    TEST_ASSERT_EQUAL(1, arena.getOverflows());
+    // no block at all
+    SmsHandle none;
+    TEST_ASSERT_FALSE(arena.append(none, "x"));
+    TEST_ASSERT_FALSE(none.valid());
+
+    for (auto &handle : h)
+        arena.release(handle);
+    TEST_ASSERT_EQUAL(SmsArena::BLOCK_COUNT, arena.getFreeBlocks());
+}
+
+static void test_copy_truncated_to_buffer() {
+    SmsArena arena;
+    SmsHandle h;
+    arena.append(h, pattern(2 * BLOCK), 2 * BLOCK);
+    FixedString<BLOCK + 5> text;
+    TEST_ASSERT_EQUAL(BLOCK + 4, arena.copy(h, text));
+    TEST_ASSERT_EQUAL_STRING(pattern(BLOCK + 4), text.c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_block_chaining_exact_multiples);
+    RUN_TEST(test_appends_across_blocks);
+    RUN_TEST(test_empty_append);
+    RUN_TEST(test_max_length_clamp);
+    RUN_TEST(test_max_length_exact);
+    RUN_TEST(test_overflow_counted_once_per_body);
+    RUN_TEST(test_exhausted_arena);
+    RUN_TEST(test_copy_truncated_to_buffer);
+    return UNITY_END();
+}